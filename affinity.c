@@ -0,0 +1,212 @@
+/*
+ * affinity.c
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include "affinity.h"
+#include "cache_line.h"
+
+typedef struct {
+    int cpu;
+    int package;
+    int core;
+    int sibling; /* 0 for the first hardware thread of a core, 1 for the next... */
+} cpu_topology;
+
+static int readTopology(int cpu, const char *name)
+{
+    char path[128];
+    int value = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *f = fopen(path, "r");
+    if (f != NULL) {
+        if (fscanf(f, "%d", &value) != 1) {
+            value = 0;
+        }
+        fclose(f);
+    }
+    return value; // unknown topology: everything on package 0, core 0
+}
+
+static int byCompact(const void *a, const void *b)
+{
+    const cpu_topology *x = a, *y = b;
+    if (x->package != y->package) {
+        return x->package - y->package;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    return x->cpu - y->cpu;
+}
+
+static int byScatter(const void *a, const void *b)
+{
+    const cpu_topology *x = a, *y = b;
+    if (x->sibling != y->sibling) {
+        return x->sibling - y->sibling;
+    }
+    if (x->core != y->core) {
+        return x->core - y->core;
+    }
+    if (x->package != y->package) {
+        return x->package - y->package;
+    }
+    return x->cpu - y->cpu;
+}
+
+/*
+ * parse "0,2,8-11" into cpus, keeping only allowed ones
+ * returns the number of CPUs, or -1 on a malformed list
+ */
+static int parseList(const char *spec, const cpu_set_t *allowed, int *cpus, int capacity)
+{
+    int count = 0;
+    const char *p = spec;
+    while (*p != '\0') {
+        char *end;
+        long first = strtol(p, &end, 10), last;
+        if (end == p || first < 0) {
+            return -1;
+        }
+        last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                return -1;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET((int) cpu, allowed) && count < capacity) {
+                cpus[count++] = (int) cpu;
+            }
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+    return count;
+}
+
+int affinityPlanInit(affinity_plan *plan, const char *spec)
+{
+    cpu_set_t allowed;
+    cpu_topology *topology;
+    int count = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        perror("sched_getaffinity");
+        return -1;
+    }
+    plan->cpus = malloc(CPU_SETSIZE * sizeof(int));
+    topology = malloc(CPU_SETSIZE * sizeof(cpu_topology));
+    if (plan->cpus == NULL || topology == NULL) {
+        free(plan->cpus);
+        free(topology);
+        perror("affinity plan");
+        return -1;
+    }
+
+    if (isdigit((unsigned char) spec[0])) {
+        count = parseList(spec, &allowed, plan->cpus, CPU_SETSIZE);
+        if (count <= 0) {
+            fprintf(stderr, "Invalid or unusable CPU list: '%s'\n", spec);
+            free(topology);
+            free(plan->cpus);
+            return -1;
+        }
+    } else if (strcmp(spec, "compact") == 0 || strcmp(spec, "scatter") == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                topology[count].cpu = cpu;
+                topology[count].package = readTopology(cpu, "physical_package_id");
+                topology[count].core = readTopology(cpu, "core_id");
+                topology[count].sibling = 0;
+                for (int i = 0; i < count; i++) {
+                    if (topology[i].package == topology[count].package && topology[i].core == topology[count].core) {
+                        topology[count].sibling++;
+                    }
+                }
+                count++;
+            }
+        }
+        qsort(topology, count, sizeof(cpu_topology), strcmp(spec, "compact") == 0 ? byCompact : byScatter);
+        for (int i = 0; i < count; i++) {
+            plan->cpus[i] = topology[i].cpu;
+        }
+    } else {
+        fprintf(stderr, "Unknown placement: '%s'. Expected value: compact, scatter or a CPU list\n", spec);
+        free(topology);
+        free(plan->cpus);
+        return -1;
+    }
+    free(topology);
+    plan->num_cpus = count;
+    return 0;
+}
+
+void affinityPlanDestroy(affinity_plan *plan)
+{
+    free(plan->cpus);
+    plan->cpus = NULL;
+    plan->num_cpus = 0;
+}
+
+int affinityCpuFor(const affinity_plan *plan, int thread_index)
+{
+    return plan->cpus[thread_index % plan->num_cpus];
+}
+
+int affinityNodeOfCpu(int cpu)
+{
+#ifdef HAVE_LIBNUMA
+    if (numa_available() >= 0) {
+        int node = numa_node_of_cpu(cpu);
+        return node >= 0 ? node : 0;
+    }
+#endif
+    (void) cpu;
+    return 0;
+}
+
+void *affinityAlloc(size_t size, int node)
+{
+#ifdef HAVE_LIBNUMA
+    if (node >= 0 && numa_available() >= 0) {
+        return numa_alloc_onnode(size, node); // page aligned
+    }
+#endif
+    (void) node;
+    size = (size + CACHE_LINE_SIZE - 1) & ~(size_t) (CACHE_LINE_SIZE - 1);
+    return aligned_alloc(CACHE_LINE_SIZE, size);
+}
+
+void affinityFree(void *memory, size_t size, int node)
+{
+    if (memory == NULL) {
+        return;
+    }
+#ifdef HAVE_LIBNUMA
+    if (node >= 0 && numa_available() >= 0) {
+        numa_free(memory, size);
+        return;
+    }
+#endif
+    (void) size;
+    (void) node;
+    free(memory);
+}
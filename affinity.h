@@ -0,0 +1,45 @@
+/*
+ * affinity.h
+ *
+ * Thread placement (--pin) and NUMA-local memory:
+ *  - compact  fill one core after the other, hyperthread siblings adjacent
+ *  - scatter  round-robin across sockets, then across cores, siblings last
+ *  - LIST     explicit CPUs, e.g. "0,2,8-11", used in order
+ * Thread i (the master is thread 0) runs on the i-th CPU of the plan,
+ * wrapping around when there are more threads than CPUs.
+ * NUMA queries and node-local allocation use libnuma when the build found
+ * it (HAVE_LIBNUMA) and fall back to a single node otherwise.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    int *cpus;    /* placement order */
+    int num_cpus;
+} affinity_plan;
+
+/*
+ * build a plan from a spec (see above) limited to the CPUs this process may use
+ * returns 0 on success, -1 after printing the reason to stderr
+ */
+int affinityPlanInit(affinity_plan *plan, const char *spec);
+void affinityPlanDestroy(affinity_plan *plan);
+
+/* CPU for thread i of the plan */
+int affinityCpuFor(const affinity_plan *plan, int thread_index);
+
+/* node of a CPU, 0 without libnuma or for unknown CPUs */
+int affinityNodeOfCpu(int cpu);
+
+/*
+ * cache-line-aligned memory on a NUMA node (any node when node < 0)
+ * must be released with affinityFree using the same size and node
+ */
+void *affinityAlloc(size_t size, int node);
+void affinityFree(void *memory, size_t size, int node);
+
+#endif
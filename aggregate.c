@@ -0,0 +1,222 @@
+/*
+ * aggregate.c
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aggregate.h"
+#include "aggregate_simd.h"
+#include "aggregate_sketch.h"
+#include "cache_line.h"
+
+typedef struct {
+    long sum;
+    long odd;
+    long min;
+    long max;
+} basic_state;
+
+static void basicInit(void *state)
+{
+    basic_state *b = state;
+    b->sum = 0;
+    b->odd = 0;
+    b->min = INT_MAX;
+    b->max = INT_MIN;
+}
+
+static void basicAdd(void *state, long number)
+{
+    basic_state *b = state;
+    b->sum += number;
+    if (number % 2 == 1) {
+        b->odd++;
+    }
+    if (number < b->min) {
+        b->min = number;
+    }
+    if (number > b->max) {
+        b->max = number;
+    }
+}
+
+static void basicAddArray(void *state, const long *numbers, size_t count)
+{
+    basic_state *b = state;
+    basicReduce(&b->sum, &b->odd, &b->min, &b->max, numbers, count);
+}
+
+static void basicMerge(void *into, const void *from)
+{
+    basic_state *a = into;
+    const basic_state *b = from;
+    a->sum += b->sum;
+    a->odd += b->odd;
+    if (b->min < a->min) {
+        a->min = b->min;
+    }
+    if (b->max > a->max) {
+        a->max = b->max;
+    }
+}
+
+static void basicPrint(const void *state, FILE *out)
+{
+    const basic_state *b = state;
+    fprintf(out, "%ld %ld %ld %ld\n", b->sum, b->odd, b->min, b->max);
+}
+
+const aggregate_ops basic_aggregate = {
+    .name = "basic",
+    .size = sizeof(basic_state),
+    .init = basicInit,
+    .add = basicAdd,
+    .add_array = basicAddArray,
+    .merge = basicMerge,
+    .print = basicPrint,
+};
+
+static const aggregate_ops *const known_aggregates[] = {
+    &basic_aggregate, &welford_aggregate, &histogram_aggregate, &tdigest_aggregate, &hll_aggregate,
+};
+
+bool aggregateListParse(const char *text, const aggregate_ops **ops, size_t *count)
+{
+    size_t n = 0;
+
+    for (;;) {
+        size_t length = strcspn(text, ",");
+        const aggregate_ops *found = NULL;
+        for (size_t i = 0; i < sizeof(known_aggregates) / sizeof(known_aggregates[0]); i++) {
+            if (strlen(known_aggregates[i]->name) == length && strncmp(text, known_aggregates[i]->name, length) == 0) {
+                found = known_aggregates[i];
+            }
+        }
+        for (size_t i = 0; found != NULL && i < n; i++) {
+            if (ops[i] == found) {
+                found = NULL;
+            }
+        }
+        if (found == NULL || n == AGGREGATE_MAX) {
+            return false;
+        }
+        ops[n++] = found;
+        if (text[length] == '\0') {
+            break;
+        }
+        text += length + 1;
+    }
+    *count = n;
+    return true;
+}
+
+int accumulatorInit(accumulator *acc, const aggregate_ops *const *ops, size_t count)
+{
+    size_t size = 0;
+
+    if (count > AGGREGATE_MAX) {
+        return -1;
+    }
+    acc->count = count;
+    for (size_t i = 0; i < count; i++) {
+        acc->ops[i] = ops[i];
+        acc->offsets[i] = size;
+        // keep every state 16-byte aligned
+        size += (ops[i]->size + 15) & ~(size_t) 15;
+    }
+    // a whole number of cache lines so no two accumulators share one
+    size = (size + CACHE_LINE_SIZE - 1) & ~(size_t) (CACHE_LINE_SIZE - 1);
+    if (size == 0) {
+        size = CACHE_LINE_SIZE;
+    }
+    acc->states = aligned_alloc(CACHE_LINE_SIZE, size);
+    if (acc->states == NULL) {
+        return -1;
+    }
+    accumulatorReset(acc);
+    return 0;
+}
+
+void accumulatorDestroy(accumulator *acc)
+{
+    free(acc->states);
+    acc->states = NULL;
+    acc->count = 0;
+}
+
+void accumulatorAdd(accumulator *acc, long number)
+{
+    for (size_t i = 0; i < acc->count; i++) {
+        acc->ops[i]->add(acc->states + acc->offsets[i], number);
+    }
+}
+
+void accumulatorAddArray(accumulator *acc, const long *numbers, size_t count)
+{
+    for (size_t i = 0; i < acc->count; i++) {
+        void *state = acc->states + acc->offsets[i];
+        if (acc->ops[i]->add_array != NULL) {
+            acc->ops[i]->add_array(state, numbers, count);
+            continue;
+        }
+        for (size_t j = 0; j < count; j++) {
+            acc->ops[i]->add(state, numbers[j]);
+        }
+    }
+}
+
+void accumulatorMerge(accumulator *into, const accumulator *from)
+{
+    for (size_t i = 0; i < into->count; i++) {
+        into->ops[i]->merge(into->states + into->offsets[i], from->states + from->offsets[i]);
+    }
+}
+
+void accumulatorReset(accumulator *acc)
+{
+    for (size_t i = 0; i < acc->count; i++) {
+        acc->ops[i]->init(acc->states + acc->offsets[i]);
+    }
+}
+
+size_t accumulatorStateSize(const accumulator *acc)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < acc->count; i++) {
+        size += acc->ops[i]->size;
+    }
+    return size;
+}
+
+void accumulatorSave(const accumulator *acc, void *out)
+{
+    unsigned char *p = out;
+    for (size_t i = 0; i < acc->count; i++) {
+        memcpy(p, acc->states + acc->offsets[i], acc->ops[i]->size);
+        p += acc->ops[i]->size;
+    }
+}
+
+bool accumulatorLoad(accumulator *acc, const void *in)
+{
+    const unsigned char *p = in;
+    for (size_t i = 0; i < acc->count; i++) {
+        // copied first: the input carries no alignment
+        memcpy(acc->states + acc->offsets[i], p, acc->ops[i]->size);
+        p += acc->ops[i]->size;
+        if (acc->ops[i]->valid != NULL && !acc->ops[i]->valid(acc->states + acc->offsets[i])) {
+            accumulatorReset(acc);
+            return false;
+        }
+    }
+    return true;
+}
+
+void accumulatorPrint(const accumulator *acc, FILE *out)
+{
+    for (size_t i = 0; i < acc->count; i++) {
+        acc->ops[i]->print(acc->states + acc->offsets[i], out);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * aggregate.h
+ *
+ * Pluggable reductions over task values. Every worker owns a private
+ * accumulator and the accumulators are merged once the workers joined,
+ * so the hot path never touches shared state.
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define AGGREGATE_MAX 8
+
+/* operations of one reduction over a fixed-size state */
+typedef struct {
+    const char *name;
+    size_t size;
+    void (*init)(void *state);
+    void (*add)(void *state, long number);
+    /* optional: add count numbers at once, e.g. vectorized */
+    void (*add_array)(void *state, const long *numbers, size_t count);
+    void (*merge)(void *into, const void *from);
+    void (*print)(const void *state, FILE *out);
+    /* optional: whether a state loaded from outside is safe to merge and print; NULL if any bytes are */
+    bool (*valid)(const void *state);
+} aggregate_ops;
+
+/* the classic "sum odd min max" output */
+extern const aggregate_ops basic_aggregate;
+
+/*
+ * parse a comma-separated list of reduction names (basic, welford, histogram,
+ * tdigest, hll) into ops, at most AGGREGATE_MAX of them
+ * returns false on an unknown or repeated name
+ */
+bool aggregateListParse(const char *text, const aggregate_ops **ops, size_t *count);
+
+/* states of several reductions packed in one cache-line-aligned block */
+typedef struct {
+    size_t count;
+    const aggregate_ops *ops[AGGREGATE_MAX];
+    size_t offsets[AGGREGATE_MAX];
+    unsigned char *states;
+} accumulator;
+
+/*
+ * set up an accumulator for the given reductions
+ * returns 0 on success, -1 on allocation failure or too many reductions
+ */
+int accumulatorInit(accumulator *acc, const aggregate_ops *const *ops, size_t count);
+void accumulatorDestroy(accumulator *acc);
+
+void accumulatorAdd(accumulator *acc, long number);
+/* same as adding the numbers one by one, using the reductions' bulk adds where they have one */
+void accumulatorAddArray(accumulator *acc, const long *numbers, size_t count);
+/* fold "from" into "into"; both must have been set up with the same reductions */
+void accumulatorMerge(accumulator *into, const accumulator *from);
+/* reset every state to its initial value */
+void accumulatorReset(accumulator *acc);
+
+/*
+ * raw copy of the states, packed back to back; only meaningful to a process
+ * running the same binary with the same reductions
+ */
+size_t accumulatorStateSize(const accumulator *acc);
+void accumulatorSave(const accumulator *acc, void *out);
+/*
+ * the bytes come from a peer or a file: every state is checked once copied
+ * returns false, with every state reset, when a reduction rejects its state
+ */
+bool accumulatorLoad(accumulator *acc, const void *in);
+
+/* print one line per reduction */
+void accumulatorPrint(const accumulator *acc, FILE *out);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * aggregate_simd.c
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#include "aggregate_simd.h"
+
+#ifdef HAVE_X86_SIMD
+_Static_assert(sizeof(long) == 8, "the vector kernels assume 64-bit longs");
+#endif
+
+typedef struct {
+    long sum;
+    long odd;
+    long min;
+    long max;
+} reduce_totals;
+
+static void reduceScalar(reduce_totals *t, const long *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        long x = values[i];
+        t->sum += x;
+        t->odd += x % 2 == 1;
+        if (x < t->min) {
+            t->min = x;
+        }
+        if (x > t->max) {
+            t->max = x;
+        }
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static void reduceAvx2(reduce_totals *t, const long *values, size_t count)
+{
+    const __m256i one = _mm256_set1_epi64x(1), zero = _mm256_setzero_si256();
+    // two sets of accumulators so consecutive vectors do not wait on each other
+    __m256i sum[2] = { zero, zero }, odd[2] = { zero, zero };
+    __m256i min[2] = { _mm256_set1_epi64x(t->min), _mm256_set1_epi64x(t->min) };
+    __m256i max[2] = { _mm256_set1_epi64x(t->max), _mm256_set1_epi64x(t->max) };
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 2; k++) {
+            __m256i x = _mm256_loadu_si256((const __m256i *) (values + i + 4 * k));
+            sum[k] = _mm256_add_epi64(sum[k], x);
+            // (x & 1) is 1 for odd values, the compare keeps the positive ones
+            odd[k] = _mm256_add_epi64(odd[k], _mm256_and_si256(_mm256_and_si256(x, one), _mm256_cmpgt_epi64(x, zero)));
+            min[k] = _mm256_blendv_epi8(min[k], x, _mm256_cmpgt_epi64(min[k], x));
+            max[k] = _mm256_blendv_epi8(max[k], x, _mm256_cmpgt_epi64(x, max[k]));
+        }
+    }
+
+    // fold the lanes
+    long lanes[4][4];
+    _mm256_storeu_si256((__m256i *) lanes[0], _mm256_add_epi64(sum[0], sum[1]));
+    _mm256_storeu_si256((__m256i *) lanes[1], _mm256_add_epi64(odd[0], odd[1]));
+    _mm256_storeu_si256((__m256i *) lanes[2], _mm256_blendv_epi8(min[0], min[1], _mm256_cmpgt_epi64(min[0], min[1])));
+    _mm256_storeu_si256((__m256i *) lanes[3], _mm256_blendv_epi8(max[0], max[1], _mm256_cmpgt_epi64(max[1], max[0])));
+    for (int lane = 0; lane < 4; lane++) {
+        t->sum += lanes[0][lane];
+        t->odd += lanes[1][lane];
+        if (lanes[2][lane] < t->min) {
+            t->min = lanes[2][lane];
+        }
+        if (lanes[3][lane] > t->max) {
+            t->max = lanes[3][lane];
+        }
+    }
+    reduceScalar(t, values + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void reduceAvx512(reduce_totals *t, const long *values, size_t count)
+{
+    const __m512i one = _mm512_set1_epi64(1), zero = _mm512_setzero_si512();
+    __m512i sum[2] = { zero, zero }, odd[2] = { zero, zero };
+    __m512i min[2] = { _mm512_set1_epi64(t->min), _mm512_set1_epi64(t->min) };
+    __m512i max[2] = { _mm512_set1_epi64(t->max), _mm512_set1_epi64(t->max) };
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        for (int k = 0; k < 2; k++) {
+            __m512i x = _mm512_loadu_si512((const void *) (values + i + 8 * k));
+            sum[k] = _mm512_add_epi64(sum[k], x);
+            __mmask8 positive_odd = _mm512_test_epi64_mask(x, one) & _mm512_cmpgt_epi64_mask(x, zero);
+            odd[k] = _mm512_mask_add_epi64(odd[k], positive_odd, odd[k], one);
+            min[k] = _mm512_min_epi64(min[k], x);
+            max[k] = _mm512_max_epi64(max[k], x);
+        }
+    }
+
+    t->sum += _mm512_reduce_add_epi64(_mm512_add_epi64(sum[0], sum[1]));
+    t->odd += _mm512_reduce_add_epi64(_mm512_add_epi64(odd[0], odd[1]));
+    t->min = _mm512_reduce_min_epi64(_mm512_min_epi64(min[0], min[1]));
+    t->max = _mm512_reduce_max_epi64(_mm512_max_epi64(max[0], max[1]));
+    reduceScalar(t, values + i, count - i);
+}
+#endif
+
+/* kernel chosen once on the first call, which may come from several workers */
+static void (*reduce_kernel)(reduce_totals *t, const long *values, size_t count);
+static pthread_once_t reduce_once = PTHREAD_ONCE_INIT;
+
+static void selectKernel(void)
+{
+    reduce_kernel = reduceScalar;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        reduce_kernel = reduceAvx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        reduce_kernel = reduceAvx2;
+    }
+#endif
+}
+
+void basicReduce(long *sum, long *odd, long *min, long *max, const long *values, size_t count)
+{
+    reduce_totals t = { *sum, *odd, *min, *max };
+    pthread_once(&reduce_once, selectKernel);
+    reduce_kernel(&t, values, count);
+    *sum = t.sum;
+    *odd = t.odd;
+    *min = t.min;
+    *max = t.max;
+}
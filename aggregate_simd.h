@@ -0,0 +1,18 @@
+/*
+ * aggregate_simd.h
+ *
+ * Vectorized "sum odd min max" over an array of values, for when the values
+ * are already in memory and nothing is simulated per task. The widest
+ * kernel the CPU supports (AVX-512, AVX2, or plain C) is chosen on the
+ * first call; every kernel gives the same result as adding one by one.
+ */
+
+#ifndef AGGREGATE_SIMD_H
+#define AGGREGATE_SIMD_H
+
+#include <stddef.h>
+
+/* fold count values into the running totals; odd counts x % 2 == 1, i.e. positive odd values */
+void basicReduce(long *sum, long *odd, long *min, long *max, const long *values, size_t count);
+
+#endif
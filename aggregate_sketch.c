@@ -0,0 +1,428 @@
+/*
+ * aggregate_sketch.c
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aggregate_sketch.h"
+
+/* welford */
+
+typedef struct {
+    double count;
+    double mean;
+    double m2;    /* sum of squared distances to the mean */
+} welford_state;
+
+static void welfordInit(void *state)
+{
+    memset(state, 0, sizeof(welford_state));
+}
+
+static void welfordAdd(void *state, long number)
+{
+    welford_state *w = state;
+    double delta = (double) number - w->mean;
+    w->count += 1.0;
+    w->mean += delta / w->count;
+    w->m2 += delta * ((double) number - w->mean);
+}
+
+static void welfordMerge(void *into, const void *from)
+{
+    welford_state *a = into;
+    const welford_state *b = from;
+    double count = a->count + b->count;
+    if (b->count == 0.0) {
+        return;
+    }
+    double delta = b->mean - a->mean;
+    a->mean += delta * b->count / count;
+    a->m2 += b->m2 + delta * delta * a->count * b->count / count;
+    a->count = count;
+}
+
+static bool welfordValid(const void *state)
+{
+    const welford_state *w = state;
+    return isfinite(w->count) && w->count >= 0.0 && isfinite(w->mean) && isfinite(w->m2) && w->m2 >= 0.0;
+}
+
+static void welfordPrint(const void *state, FILE *out)
+{
+    const welford_state *w = state;
+    double variance = w->count > 1.0 ? w->m2 / (w->count - 1.0) : 0.0;
+    fprintf(out, "welford count %.0f mean %.6f variance %.6f stddev %.6f\n",
+            w->count, w->mean, variance, sqrt(variance));
+}
+
+const aggregate_ops welford_aggregate = {
+    .name = "welford",
+    .size = sizeof(welford_state),
+    .init = welfordInit,
+    .add = welfordAdd,
+    .merge = welfordMerge,
+    .print = welfordPrint,
+    .valid = welfordValid,
+};
+
+/* histogram: [0, 64) negative magnitudes, 64 zero, [65, 129) positive magnitudes */
+
+#define HISTOGRAM_ZERO 64
+#define HISTOGRAM_BUCKETS 129
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+} histogram_state;
+
+static void histogramInit(void *state)
+{
+    memset(state, 0, sizeof(histogram_state));
+}
+
+static void histogramAdd(void *state, long number)
+{
+    histogram_state *h = state;
+    if (number == 0) {
+        h->counts[HISTOGRAM_ZERO]++;
+        return;
+    }
+    // magnitude as unsigned, so LONG_MIN does not overflow
+    unsigned long long magnitude = number < 0 ? 0ull - (unsigned long long) number : (unsigned long long) number;
+    int bit = 63 - __builtin_clzll(magnitude);
+    h->counts[number < 0 ? HISTOGRAM_ZERO - 1 - bit : HISTOGRAM_ZERO + 1 + bit]++;
+}
+
+static void histogramMerge(void *into, const void *from)
+{
+    histogram_state *a = into;
+    const histogram_state *b = from;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        a->counts[i] += b->counts[i];
+    }
+}
+
+/* one "low..high:count" per non-empty bucket, in value order */
+static void histogramPrint(const void *state, FILE *out)
+{
+    const histogram_state *h = state;
+    fprintf(out, "histogram");
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        unsigned long long count = (unsigned long long) h->counts[i];
+        if (count == 0) {
+            continue;
+        }
+        if (i == HISTOGRAM_ZERO) {
+            fprintf(out, " 0:%llu", count);
+            continue;
+        }
+        int bit = i < HISTOGRAM_ZERO ? HISTOGRAM_ZERO - 1 - i : i - HISTOGRAM_ZERO - 1;
+        unsigned long long low = 1ull << bit;
+        unsigned long long high = bit == 63 ? ~0ull : (2ull << bit) - 1;
+        if (i < HISTOGRAM_ZERO) {
+            fprintf(out, " -%llu..-%llu:%llu", high, low, count);
+        } else {
+            fprintf(out, " %llu..%llu:%llu", low, high, count);
+        }
+    }
+    fprintf(out, "\n");
+}
+
+const aggregate_ops histogram_aggregate = {
+    .name = "histogram",
+    .size = sizeof(histogram_state),
+    .init = histogramInit,
+    .add = histogramAdd,
+    .merge = histogramMerge,
+    .print = histogramPrint,
+};
+
+/*
+ * tdigest: new values go to a buffer; a full buffer is sorted together with
+ * the centroids and merged into centroids no wider than the k1 scale function
+ * allows, which keeps at most TDIGEST_COMPRESSION of them
+ */
+
+#define TDIGEST_CENTROIDS (TDIGEST_COMPRESSION + 28)
+#define TDIGEST_BUFFER 256
+
+typedef struct {
+    double mean;
+    double weight;
+} centroid;
+
+typedef struct {
+    double total;    /* weight of the centroids, buffer excluded */
+    double min, max;
+    uint32_t num_centroids;
+    uint32_t num_buffered;
+    centroid centroids[TDIGEST_CENTROIDS];
+    double buffer[TDIGEST_BUFFER];
+} tdigest_state;
+
+static void tdigestInit(void *state)
+{
+    tdigest_state *t = state;
+    t->total = 0.0;
+    t->min = INFINITY;
+    t->max = -INFINITY;
+    t->num_centroids = 0;
+    t->num_buffered = 0;
+}
+
+static int compareCentroids(const void *a, const void *b)
+{
+    double x = ((const centroid *) a)->mean, y = ((const centroid *) b)->mean;
+    return (x > y) - (x < y);
+}
+
+/* k1 scale function and its inverse */
+static double scaleK(double q)
+{
+    return TDIGEST_COMPRESSION / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+static double scaleQ(double k)
+{
+    if (k >= TDIGEST_COMPRESSION / 4.0) {
+        return 1.0;
+    }
+    return (sin(k * 2.0 * M_PI / TDIGEST_COMPRESSION) + 1.0) / 2.0;
+}
+
+/*
+ * replace the centroids with the merge of items (sorted here), which must
+ * include the current centroids
+ */
+static void tdigestCompress(tdigest_state *t, centroid *items, size_t count)
+{
+    double total = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        total += items[i].weight;
+    }
+    t->total = total;
+    t->num_buffered = 0;
+    t->num_centroids = 0;
+    if (count == 0) {
+        return;
+    }
+    qsort(items, count, sizeof(centroid), compareCentroids);
+
+    centroid current = items[0];
+    double before = 0.0; // weight left of current
+    double limit = total * scaleQ(scaleK(0.0) + 1.0);
+    for (size_t i = 1; i < count; i++) {
+        if (before + current.weight + items[i].weight <= limit
+            || t->num_centroids == TDIGEST_CENTROIDS - 1) {
+            current.mean += (items[i].mean - current.mean) * items[i].weight / (current.weight + items[i].weight);
+            current.weight += items[i].weight;
+            continue;
+        }
+        t->centroids[t->num_centroids++] = current;
+        before += current.weight;
+        limit = total * scaleQ(scaleK(before / total) + 1.0);
+        current = items[i];
+    }
+    t->centroids[t->num_centroids++] = current;
+}
+
+/* the centroids and the buffered values as items */
+static size_t tdigestItems(const tdigest_state *t, centroid *items)
+{
+    memcpy(items, t->centroids, t->num_centroids * sizeof(centroid));
+    for (uint32_t i = 0; i < t->num_buffered; i++) {
+        items[t->num_centroids + i] = (centroid) { t->buffer[i], 1.0 };
+    }
+    return t->num_centroids + t->num_buffered;
+}
+
+static void tdigestAdd(void *state, long number)
+{
+    tdigest_state *t = state;
+    double value = (double) number;
+    if (value < t->min) {
+        t->min = value;
+    }
+    if (value > t->max) {
+        t->max = value;
+    }
+    t->buffer[t->num_buffered++] = value;
+    if (t->num_buffered == TDIGEST_BUFFER) {
+        centroid items[TDIGEST_CENTROIDS + TDIGEST_BUFFER];
+        tdigestCompress(t, items, tdigestItems(t, items));
+    }
+}
+
+static void tdigestMerge(void *into, const void *from)
+{
+    tdigest_state *a = into;
+    const tdigest_state *b = from;
+    centroid items[2 * (TDIGEST_CENTROIDS + TDIGEST_BUFFER)];
+    size_t count = tdigestItems(a, items);
+    count += tdigestItems(b, items + count);
+    if (b->min < a->min) {
+        a->min = b->min;
+    }
+    if (b->max > a->max) {
+        a->max = b->max;
+    }
+    tdigestCompress(a, items, count);
+}
+
+/* counts within the arrays, positive weights, and nothing NaN or infinite but an empty min and max */
+static bool tdigestValid(const void *state)
+{
+    const tdigest_state *t = state;
+    if (t->num_centroids > TDIGEST_CENTROIDS || t->num_buffered >= TDIGEST_BUFFER
+        || !isfinite(t->total) || t->total < 0.0 || isnan(t->min) || isnan(t->max)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < t->num_centroids; i++) {
+        if (!isfinite(t->centroids[i].mean) || !isfinite(t->centroids[i].weight) || t->centroids[i].weight <= 0.0) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < t->num_buffered; i++) {
+        if (!isfinite(t->buffer[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* interpolate between centroid centers, and towards min and max at the ends */
+static double tdigestQuantile(const tdigest_state *t, double q)
+{
+    const centroid *c = t->centroids;
+    uint32_t n = t->num_centroids;
+    double target = q * t->total;
+    double left = 0.0; // weight before c[i]
+
+    if (n == 0) {
+        return NAN;
+    }
+    if (target < c[0].weight / 2.0) {
+        return t->min + (c[0].mean - t->min) * target / (c[0].weight / 2.0);
+    }
+    for (uint32_t i = 0; i + 1 < n; i++) {
+        double center = left + c[i].weight / 2.0;
+        double next_center = left + c[i].weight + c[i + 1].weight / 2.0;
+        if (target < next_center) {
+            return c[i].mean + (c[i + 1].mean - c[i].mean) * (target - center) / (next_center - center);
+        }
+        left += c[i].weight;
+    }
+    double center = left + c[n - 1].weight / 2.0;
+    double rest = t->total - center;
+    return rest > 0.0 ? c[n - 1].mean + (t->max - c[n - 1].mean) * (target - center) / rest : t->max;
+}
+
+static void tdigestPrint(const void *state, FILE *out)
+{
+    // flush the buffer on a copy, the state itself is read-only here
+    tdigest_state t;
+    centroid items[TDIGEST_CENTROIDS + TDIGEST_BUFFER];
+    memcpy(&t, state, sizeof(t));
+    tdigestCompress(&t, items, tdigestItems(&t, items));
+    fprintf(out, "tdigest p50 %.2f p99 %.2f\n", tdigestQuantile(&t, 0.5), tdigestQuantile(&t, 0.99));
+}
+
+const aggregate_ops tdigest_aggregate = {
+    .name = "tdigest",
+    .size = sizeof(tdigest_state),
+    .init = tdigestInit,
+    .add = tdigestAdd,
+    .merge = tdigestMerge,
+    .print = tdigestPrint,
+    .valid = tdigestValid,
+};
+
+/* hll */
+
+#define HLL_REGISTERS (1u << HLL_PRECISION)
+
+typedef struct {
+    uint8_t registers[HLL_REGISTERS];
+} hll_state;
+
+static void hllInit(void *state)
+{
+    memset(state, 0, sizeof(hll_state));
+}
+
+/* murmur3's 64-bit finalizer */
+static uint64_t hash64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static void hllAdd(void *state, long number)
+{
+    hll_state *h = state;
+    uint64_t hash = hash64((uint64_t) number);
+    uint32_t index = (uint32_t) (hash >> (64 - HLL_PRECISION));
+    // a guard bit keeps the rank within the remaining 64 - HLL_PRECISION bits
+    uint64_t rest = (hash << HLL_PRECISION) | (1ull << (HLL_PRECISION - 1));
+    uint8_t rank = (uint8_t) (__builtin_clzll(rest) + 1);
+    if (rank > h->registers[index]) {
+        h->registers[index] = rank;
+    }
+}
+
+static void hllMerge(void *into, const void *from)
+{
+    hll_state *a = into;
+    const hll_state *b = from;
+    for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+        if (b->registers[i] > a->registers[i]) {
+            a->registers[i] = b->registers[i];
+        }
+    }
+}
+
+/* ranks never exceed the bits left after the index, plus one */
+static bool hllValid(const void *state)
+{
+    const hll_state *h = state;
+    for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+        if (h->registers[i] > 65 - HLL_PRECISION) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void hllPrint(const void *state, FILE *out)
+{
+    const hll_state *h = state;
+    double m = HLL_REGISTERS, sum = 0.0;
+    unsigned zeros = 0;
+    for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -h->registers[i]);
+        zeros += h->registers[i] == 0;
+    }
+    double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        // small range: linear counting over the empty registers
+        estimate = m * log(m / zeros);
+    }
+    fprintf(out, "hll distinct %.0f\n", estimate);
+}
+
+const aggregate_ops hll_aggregate = {
+    .name = "hll",
+    .size = sizeof(hll_state),
+    .init = hllInit,
+    .add = hllAdd,
+    .merge = hllMerge,
+    .print = hllPrint,
+    .valid = hllValid,
+};
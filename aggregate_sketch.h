@@ -0,0 +1,29 @@
+/*
+ * aggregate_sketch.h
+ *
+ * Statistical reductions with a fixed-size state, so a worker's memory does
+ * not grow with the input and two workers' states merge at the join:
+ *
+ *   welford    count, mean and sample variance (Welford's online update,
+ *              Chan's formula to merge)
+ *   histogram  counts per power-of-two magnitude, for each sign
+ *   tdigest    merging t-digest (compression TDIGEST_COMPRESSION) giving p50
+ *              and p99
+ *   hll        HyperLogLog with 2^HLL_PRECISION registers giving an
+ *              approximate distinct count (about 1.6% standard error)
+ */
+
+#ifndef AGGREGATE_SKETCH_H
+#define AGGREGATE_SKETCH_H
+
+#include "aggregate.h"
+
+#define TDIGEST_COMPRESSION 100
+#define HLL_PRECISION 12
+
+extern const aggregate_ops welford_aggregate;
+extern const aggregate_ops histogram_aggregate;
+extern const aggregate_ops tdigest_aggregate;
+extern const aggregate_ops hll_aggregate;
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * async_exec.c
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "async_exec.h"
+#include "log.h"
+
+typedef struct {
+    uint64_t deadline_ns;
+    long value;
+} timer_entry;
+
+/* min-heap of the in-flight tasks of one loop, by deadline */
+typedef struct {
+    timer_entry *entries;
+    size_t size, capacity;
+} timer_heap;
+
+static int timerHeapPush(timer_heap *heap, timer_entry entry)
+{
+    if (heap->size == heap->capacity) {
+        size_t capacity = heap->capacity ? 2 * heap->capacity : 1024;
+        timer_entry *entries = realloc(heap->entries, capacity * sizeof(timer_entry));
+        if (entries == NULL) {
+            return -1;
+        }
+        heap->entries = entries;
+        heap->capacity = capacity;
+    }
+    size_t i = heap->size++;
+    while (i > 0 && heap->entries[(i - 1) / 2].deadline_ns > entry.deadline_ns) {
+        heap->entries[i] = heap->entries[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->entries[i] = entry;
+    return 0;
+}
+
+static timer_entry timerHeapPop(timer_heap *heap)
+{
+    timer_entry top = heap->entries[0];
+    timer_entry last = heap->entries[--heap->size];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size && heap->entries[child + 1].deadline_ns < heap->entries[child].deadline_ns) {
+            child++;
+        }
+        if (heap->entries[child].deadline_ns >= last.deadline_ns) {
+            break;
+        }
+        heap->entries[i] = heap->entries[child];
+        i = child;
+    }
+    heap->entries[i] = last;
+    return top;
+}
+
+int asyncDoorbellInit(async_doorbell *bell, int count)
+{
+    bell->bells = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(async_bell));
+    if (bell->bells == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        atomic_init(&bell->bells[i].idle, false);
+        bell->bells[i].fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (bell->bells[i].fd < 0) {
+            return -1;
+        }
+    }
+    bell->count = count;
+    atomic_init(&bell->next_ring, 0);
+    atomic_init(&bell->num_idle, 0);
+    return 0;
+}
+
+void asyncDoorbellDestroy(async_doorbell *bell)
+{
+    for (int i = 0; i < bell->count; i++) {
+        close(bell->bells[i].fd);
+    }
+    free(bell->bells);
+    bell->bells = NULL;
+}
+
+/*
+ * wake up to n idle loops
+ */
+static void ring(async_doorbell *bell, int n)
+{
+    uint64_t one = 1;
+    // pairs with the fence in asyncRun: a loop going idle either sees the
+    // published task or is counted here
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&bell->num_idle, memory_order_relaxed) == 0) {
+        return;
+    }
+    int start = atomic_load_explicit(&bell->next_ring, memory_order_relaxed);
+    for (int i = 0; i < bell->count && n > 0; i++) {
+        async_bell *b = &bell->bells[(start + i) % bell->count];
+        if (atomic_exchange(&b->idle, false)) {
+            atomic_fetch_sub(&bell->num_idle, 1);
+            ssize_t written = write(b->fd, &one, sizeof(one));
+            (void) written; // fails only if the counter is huge: the loop is awake anyway
+            n--;
+        }
+    }
+    atomic_store_explicit(&bell->next_ring, (start + 1) % bell->count, memory_order_relaxed);
+}
+
+void asyncDoorbellRing(async_doorbell *bell)
+{
+    ring(bell, 1);
+}
+
+void asyncDoorbellRingAll(async_doorbell *bell)
+{
+    ring(bell, bell->count);
+}
+
+bool asyncKernelSupported(const task_kernel *kernel)
+{
+    return kernel->kind == KERNEL_SLEEP || kernel->kind == KERNEL_NONE;
+}
+
+/*
+ * when a task of the given value started now is over
+ */
+static uint64_t taskDeadline(const task_kernel *kernel, long value, uint64_t now)
+{
+    if (kernel->kind != KERNEL_SLEEP || value <= 0) {
+        return now;
+    }
+    return now + (uint64_t) value * 1000000000u;
+}
+
+static void armTimer(int timer_fd, const timer_heap *heap)
+{
+    // an all-zero value disarms the timer
+    struct itimerspec when = { { 0, 0 }, { 0, 0 } };
+    if (heap->size > 0) {
+        uint64_t deadline = heap->entries[0].deadline_ns;
+        when.it_value.tv_sec = (time_t) (deadline / 1000000000u);
+        when.it_value.tv_nsec = (long) (deadline % 1000000000u);
+        if (when.it_value.tv_sec == 0 && when.it_value.tv_nsec == 0) {
+            when.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &when, NULL);
+}
+
+int asyncRun(async_doorbell *bell, scheduler *sched, int worker, int thread_num, const task_kernel *kernel,
+             accumulator *partial, thread_stats *stats)
+{
+    task batch[SCHEDULE_MAX_CHUNK];
+    timer_heap heap = { NULL, 0, 0 };
+    struct epoll_event events[2];
+    int status = -1;
+    uint64_t idle_ns = 0, loop_start = statsNowNs();
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0) {
+        perror("async loop");
+        goto out;
+    }
+    struct epoll_event timer_event = { .events = EPOLLIN, .data.fd = timer_fd };
+    async_bell *self = &bell->bells[worker];
+    struct epoll_event bell_event = { .events = EPOLLIN, .data.fd = self->fd };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &timer_event) != 0
+        || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, self->fd, &bell_event) != 0) {
+        perror("epoll_ctl");
+        goto out;
+    }
+
+    for (;;) {
+        // closed is read first: an empty pop after it means every task was claimed
+        bool closed = schedulerIsClosed(sched);
+        size_t claimed = 0, count;
+        uint64_t now = statsNowNs();
+
+        // start everything queued: a task costs a heap entry, not a thread
+        while ((count = schedulerTryPopBatch(sched, worker, batch, SCHEDULE_MAX_CHUNK)) > 0) {
+            now = statsNowNs();
+            for (size_t i = 0; i < count; i++) {
+                logEvent(LOG_VERBOSE, "Worker %ld executing task: %ld seconds to finish!", thread_num, batch[i].value);
+                if (stats != NULL) {
+                    statsRecordLatency(stats, now - batch[i].enqueued_ns);
+                }
+                timer_entry entry = { taskDeadline(kernel, batch[i].value, now), batch[i].value };
+                if (timerHeapPush(&heap, entry) != 0) {
+                    perror("timer heap realloc");
+                    goto out;
+                }
+            }
+            claimed += count;
+        }
+
+        // finish whatever is due
+        now = statsNowNs();
+        while (heap.size > 0 && heap.entries[0].deadline_ns <= now) {
+            accumulatorAdd(partial, timerHeapPop(&heap).value);
+            if (stats != NULL) {
+                stats->tasks++;
+            }
+        }
+        if (closed && claimed == 0 && heap.size == 0) {
+            status = 0;
+            break;
+        }
+        armTimer(timer_fd, &heap);
+
+        // go idle, unless the master published while we were busy
+        atomic_store(&self->idle, true);
+        atomic_fetch_add(&bell->num_idle, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        int timeout = -1;
+        // after claiming, look again: an empty pop after the close may be all that is left to see
+        if (claimed > 0 || schedulerBacklog(sched) > 0 || (!closed && schedulerIsClosed(sched))) {
+            timeout = 0; // only collect a pending ring or timer, then look again
+        }
+        uint64_t idle_start = statsNowNs();
+        int ready = epoll_wait(epoll_fd, events, 2, timeout);
+        if (atomic_exchange(&self->idle, false)) {
+            // woken by the timer: nobody took us off the count
+            atomic_fetch_sub(&bell->num_idle, 1);
+        }
+        idle_ns += statsNowNs() - idle_start;
+        if (ready < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            goto out;
+        }
+        for (int i = 0; i < ready; i++) {
+            // reset the eventfd counters so they stop polling readable
+            uint64_t ticks;
+            ssize_t got = read(events[i].data.fd, &ticks, sizeof(ticks));
+            (void) got;
+        }
+    }
+    if (stats != NULL) {
+        stats->idle_ns += idle_ns;
+        stats->busy_ns += statsNowNs() - loop_start - idle_ns;
+    }
+
+out:
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    if (timer_fd >= 0) {
+        close(timer_fd);
+    }
+    free(heap.entries);
+    return status;
+}
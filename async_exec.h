@@ -0,0 +1,55 @@
+/*
+ * async_exec.h
+ *
+ * Event-loop execution for tasks that only wait: instead of blocking a
+ * thread per task, a loop thread turns every task it claims into a deadline
+ * in a min-heap and sleeps in epoll on a timerfd armed for the earliest one,
+ * so a handful of threads keep thousands of waits in flight. Every loop
+ * also polls an eventfd of its own, which the master writes to wake an idle
+ * loop when it publishes.
+ */
+
+#ifndef ASYNC_EXEC_H
+#define ASYNC_EXEC_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "aggregate.h"
+#include "cache_line.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "task_kernel.h"
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_bool idle; /* about to block or blocked in epoll */
+    int fd;                                     /* eventfd of this loop */
+} async_bell;
+
+typedef struct {
+    async_bell *bells;
+    int count;
+    atomic_int next_ring;                           /* where the next scan starts; ringers may race on it */
+    _Alignas(CACHE_LINE_SIZE) atomic_int num_idle;
+} async_doorbell;
+
+/* one bell per loop; returns 0 on success, -1 with errno set */
+int asyncDoorbellInit(async_doorbell *bell, int count);
+void asyncDoorbellDestroy(async_doorbell *bell);
+/* wake one idle loop after publishing; free while none is idle */
+void asyncDoorbellRing(async_doorbell *bell);
+/* wake every idle loop, e.g. once no more tasks will come */
+void asyncDoorbellRingAll(async_doorbell *bell);
+
+/* whether the kernel's tasks are pure waits that a loop can run as timers */
+bool asyncKernelSupported(const task_kernel *kernel);
+
+/*
+ * loop as worker (0-based) of sched until it is closed and every claimed task
+ * finished, adding each finished value to partial; stats may be NULL
+ * returns 0 on success, -1 after printing the reason
+ */
+int asyncRun(async_doorbell *bell, scheduler *sched, int worker, int thread_num, const task_kernel *kernel,
+             accumulator *partial, thread_stats *stats);
+
+#endif
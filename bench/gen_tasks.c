@@ -0,0 +1,117 @@
+/*
+ * gen_tasks.c
+ *
+ * writes synthetic task files for benchmarking sum and par_sum
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint64_t rng_state = 0x853c49e6748fea9bu;
+
+/* xorshift64*: fast, deterministic for a given seed */
+static uint64_t nextRandom(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1du;
+}
+
+/* uniform in [0, 1) */
+static double nextUnit(void)
+{
+    return (double) (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* uniform in [low, high] */
+static long nextRange(long low, long high)
+{
+    return low + (long) (nextRandom() % (uint64_t) (high - low + 1));
+}
+
+/*
+ * draw one task value from the named distribution, values mostly in [0, max]
+ */
+static long draw(const char *distribution, long max)
+{
+    if (strcmp(distribution, "bimodal") == 0) {
+        // many short tasks next to a few long ones
+        return nextUnit() < 0.9 ? nextRange(0, max / 10) : nextRange(max - max / 10, max);
+    }
+    if (strcmp(distribution, "heavy") == 0) {
+        // Pareto(alpha = 1.5) scaled so the median is about max / 20, capped at 100 * max
+        double value = (max / 20.0 + 1) / pow(1.0 - nextUnit(), 1.0 / 1.5);
+        return value > 100.0 * max ? 100 * max : (long) value;
+    }
+    return nextRange(0, max); // uniform and burst
+}
+
+int main(int argc, char *argv[])
+{
+    const char *distribution = "uniform", *out_name = NULL;
+    long count = 1000, max = 100, bursts = 4, wait = 1;
+    FILE *out = stdout;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:m:s:b:w:o:h")) != -1) {
+        switch (opt) {
+            case 'd':
+                distribution = optarg;
+                break;
+            case 'n':
+                count = (long) strtod(optarg, NULL); // accepts 1e6
+                break;
+            case 'm':
+                max = strtol(optarg, NULL, 10);
+                break;
+            case 's':
+                rng_state = strtoull(optarg, NULL, 10) * 0x9e3779b97f4a7c15u | 1;
+                break;
+            case 'b':
+                bursts = strtol(optarg, NULL, 10);
+                break;
+            case 'w':
+                wait = strtol(optarg, NULL, 10);
+                break;
+            case 'o':
+                out_name = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-d uniform|bimodal|heavy|burst] [-n tasks] [-m max value]\n"
+                                "       [-s seed] [-b bursts] [-w wait seconds between bursts] [-o file]\n", argv[0]);
+                exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (strcmp(distribution, "uniform") != 0 && strcmp(distribution, "bimodal") != 0
+        && strcmp(distribution, "heavy") != 0 && strcmp(distribution, "burst") != 0) {
+        fprintf(stderr, "Unknown distribution: '%s'\n", distribution);
+        exit(EXIT_FAILURE);
+    }
+    if (count < 0 || max < 1 || bursts < 1 || wait < 0) {
+        fprintf(stderr, "Invalid arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (out_name != NULL && (out = fopen(out_name, "w")) == NULL) {
+        perror(out_name);
+        exit(EXIT_FAILURE);
+    }
+    int burst = strcmp(distribution, "burst") == 0;
+    long per_burst = (count + bursts - 1) / bursts;
+    for (long i = 0; i < count; i++) {
+        if (burst && i > 0 && i % per_burst == 0) {
+            fprintf(out, "w %ld\n", wait);
+        }
+        fprintf(out, "p %ld\n", draw(distribution, max));
+    }
+    if (fclose(out) != 0) {
+        perror("write");
+        exit(EXIT_FAILURE);
+    }
+    return (EXIT_SUCCESS);
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+#
+# run_bench.sh <sum> <par_sum> <gen_tasks>
+#
+# Generates task files for every distribution and size, runs sum once and
+# par_sum for every thread count, and prints one CSV row per run. A run whose
+# "sum odd min max" line differs from sum's is reported as a mismatch and
+# makes the script fail.
+#
+# Tunables (environment):
+#   BENCH_DISTRIBUTIONS  default "uniform bimodal heavy burst"
+#   BENCH_SIZES          default "1000 10000 100000" (up to 1e8 works, given disk and time)
+#   BENCH_THREADS        par_sum -t values, default "2 3 5 9"
+#   BENCH_KERNEL         task kernel for both programs, default "spin:1"
+#   BENCH_MAX_VALUE      largest regular task value, default 100
+#   BENCH_PAR_ARGS       extra par_sum arguments, e.g. "-s steal"
+#   BENCH_DIR            where task files are generated, default ./bench_data
+#   BENCH_OUTPUT         CSV copy, default ./bench_results.csv
+
+set -euo pipefail
+
+if [ $# -ne 3 ]; then
+    echo "Usage: $0 <sum> <par_sum> <gen_tasks>" >&2
+    exit 1
+fi
+SUM=$1
+PAR_SUM=$2
+GEN_TASKS=$3
+
+DISTRIBUTIONS=${BENCH_DISTRIBUTIONS:-"uniform bimodal heavy burst"}
+SIZES=${BENCH_SIZES:-"1000 10000 100000"}
+THREADS=${BENCH_THREADS:-"2 3 5 9"}
+KERNEL=${BENCH_KERNEL:-"spin:1"}
+MAX_VALUE=${BENCH_MAX_VALUE:-100}
+PAR_ARGS=${BENCH_PAR_ARGS:-}
+DIR=${BENCH_DIR:-bench_data}
+OUTPUT=${BENCH_OUTPUT:-bench_results.csv}
+
+mkdir -p "$DIR"
+
+now() {
+    date +%s.%N
+}
+
+# run "$@", leaving the wall time in $elapsed and the result line in $result
+timed() {
+    local start end
+    start=$(now)
+    result=$("$@" | tail -n 1)
+    end=$(now)
+    elapsed=$(awk -v s="$start" -v e="$end" 'BEGIN { printf "%.6f", e - s }')
+}
+
+failures=0
+echo "distribution,tasks,program,threads,workers,wall_s,tasks_per_s,speedup,efficiency,result_match" | tee "$OUTPUT"
+
+for distribution in $DISTRIBUTIONS; do
+    for size in $SIZES; do
+        file="$DIR/$distribution-$size.txt"
+        if [ ! -s "$file" ]; then
+            "$GEN_TASKS" -d "$distribution" -n "$size" -m "$MAX_VALUE" -o "$file"
+        fi
+
+        timed "$SUM" -k "$KERNEL" "$file"
+        expected=$result
+        base=$elapsed
+        awk -v d="$distribution" -v n="$size" -v t="$base" 'BEGIN {
+            printf "%s,%s,sum,1,1,%s,%.1f,1.000,1.000,yes\n", d, n, t, (t > 0 ? n / t : 0)
+        }' | tee -a "$OUTPUT"
+
+        for threads in $THREADS; do
+            # shellcheck disable=SC2086
+            timed "$PAR_SUM" -t "$threads" -k "$KERNEL" $PAR_ARGS -f "$file"
+            match=yes
+            if [ "$result" != "$expected" ]; then
+                match=no
+                failures=$((failures + 1))
+                echo "mismatch on $file with -t $threads: sum '$expected', par_sum '$result'" >&2
+            fi
+            awk -v d="$distribution" -v n="$size" -v t="$elapsed" -v b="$base" -v th="$threads" -v m="$match" 'BEGIN {
+                w = th - 1
+                s = (t > 0 ? b / t : 0)
+                printf "%s,%s,par_sum,%d,%d,%s,%.1f,%.3f,%.3f,%s\n", d, n, th, w, t, (t > 0 ? n / t : 0), s, s / w, m
+            }' | tee -a "$OUTPUT"
+        done
+    done
+done
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures run(s) disagreed with sum" >&2
+    exit 1
+fi
@@ -0,0 +1,11 @@
+/*
+ * cache_line.h
+ */
+
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+/* pad/align shared data to this size to avoid false sharing between threads */
+#define CACHE_LINE_SIZE 64
+
+#endif
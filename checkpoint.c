@@ -0,0 +1,270 @@
+/*
+ * checkpoint.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "task_format.h"
+
+#define CHECKPOINT_MAGIC "MWCK"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE 28
+/* how often an idle checkpointer or a throttled master looks again */
+#define CHECKPOINT_POLL_NS 1000000L
+
+int checkpointInit(checkpointer *cp, const char *path, size_t input_size, int num_workers,
+                   const aggregate_ops *const *ops, size_t count)
+{
+    cp->path = path;
+    cp->input_size = input_size;
+    cp->num_workers = num_workers;
+    cp->records_done = 0;
+    cp->open_epoch = 0;
+    cp->epoch_open = false;
+    cp->records = 0;
+    atomic_init(&cp->completed, 0);
+    atomic_init(&cp->sealed_epochs, 0);
+    atomic_init(&cp->finished, false);
+    for (int i = 0; i < CHECKPOINT_SLOTS; i++) {
+        atomic_init(&cp->epochs[i].tasks, 0);
+        atomic_init(&cp->epochs[i].end_record, 0);
+    }
+
+    size_t num_slots = (size_t) num_workers * CHECKPOINT_SLOTS;
+    cp->slots = aligned_alloc(CACHE_LINE_SIZE, num_slots * sizeof(checkpoint_slot));
+    if (cp->slots == NULL || accumulatorInit(&cp->total, ops, count) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < num_slots; i++) {
+        atomic_init(&cp->slots[i].done, 0);
+        if (accumulatorInit(&cp->slots[i].partial, ops, count) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void checkpointDestroy(checkpointer *cp)
+{
+    for (size_t i = 0; i < (size_t) cp->num_workers * CHECKPOINT_SLOTS; i++) {
+        accumulatorDestroy(&cp->slots[i].partial);
+    }
+    free(cp->slots);
+    cp->slots = NULL;
+    accumulatorDestroy(&cp->total);
+}
+
+long long checkpointLoad(checkpointer *cp)
+{
+    size_t state_size = accumulatorStateSize(&cp->total);
+    size_t file_size = CHECKPOINT_HEADER_SIZE + state_size;
+    unsigned char *data = malloc(file_size + 1);
+    FILE *in = fopen(cp->path, "rb");
+    long long records = -1;
+
+    if (data == NULL || in == NULL) {
+        perror(cp->path);
+    } else if (fread(data, 1, file_size + 1, in) != file_size
+               || memcmp(data, CHECKPOINT_MAGIC, 4) != 0 || loadLe32(data + 4) != CHECKPOINT_VERSION
+               || loadLe32(data + 24) != state_size) {
+        fprintf(stderr, "%s: not a checkpoint of this program\n", cp->path);
+    } else if (loadLe64(data + 16) != cp->input_size) {
+        fprintf(stderr, "%s: written for an input of another size\n", cp->path);
+    } else if (!accumulatorLoad(&cp->total, data + CHECKPOINT_HEADER_SIZE)) {
+        fprintf(stderr, "%s: corrupt aggregate states\n", cp->path);
+    } else {
+        cp->records_done = loadLe64(data + 8);
+        cp->records = cp->records_done;
+        records = (long long) cp->records_done;
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+    free(data);
+    return records;
+}
+
+uint64_t checkpointRecord(checkpointer *cp, bool is_task)
+{
+    if (!cp->epoch_open) {
+        // its slots are free once the epoch CHECKPOINT_SLOTS before it completed
+        struct timespec pause = { 0, CHECKPOINT_POLL_NS };
+        while (cp->open_epoch >= atomic_load_explicit(&cp->completed, memory_order_acquire) + CHECKPOINT_SLOTS) {
+            nanosleep(&pause, NULL);
+        }
+        cp->epoch_open = true;
+    }
+    checkpoint_epoch *epoch = &cp->epochs[cp->open_epoch % CHECKPOINT_SLOTS];
+    cp->records++;
+    if (is_task) {
+        atomic_fetch_add_explicit(&epoch->tasks, 1, memory_order_relaxed);
+    }
+    return cp->open_epoch;
+}
+
+void checkpointSeal(checkpointer *cp)
+{
+    if (!cp->epoch_open) {
+        return;
+    }
+    checkpoint_epoch *epoch = &cp->epochs[cp->open_epoch % CHECKPOINT_SLOTS];
+    atomic_store_explicit(&epoch->end_record, cp->records, memory_order_relaxed);
+    cp->open_epoch++;
+    cp->epoch_open = false;
+    atomic_store_explicit(&cp->sealed_epochs, cp->open_epoch, memory_order_release);
+}
+
+void checkpointFinish(checkpointer *cp)
+{
+    checkpointSeal(cp);
+    atomic_store_explicit(&cp->finished, true, memory_order_release);
+}
+
+void checkpointAdd(checkpointer *cp, int worker, uint64_t epoch, long value)
+{
+    checkpoint_slot *slot = &cp->slots[(size_t) worker * CHECKPOINT_SLOTS + epoch % CHECKPOINT_SLOTS];
+    accumulatorAdd(&slot->partial, value);
+    // publishes the add to the checkpointer
+    atomic_fetch_add_explicit(&slot->done, 1, memory_order_release);
+}
+
+/*
+ * fold the oldest sealed epoch into the total if all its tasks are done
+ * returns false when it is still running (or none is sealed)
+ */
+static bool foldEpoch(checkpointer *cp)
+{
+    uint64_t e = atomic_load_explicit(&cp->completed, memory_order_relaxed);
+    if (e >= atomic_load_explicit(&cp->sealed_epochs, memory_order_acquire)) {
+        return false;
+    }
+    checkpoint_epoch *epoch = &cp->epochs[e % CHECKPOINT_SLOTS];
+    uint64_t done = 0;
+    for (int w = 0; w < cp->num_workers; w++) {
+        done += atomic_load_explicit(&cp->slots[(size_t) w * CHECKPOINT_SLOTS + e % CHECKPOINT_SLOTS].done,
+                                     memory_order_acquire);
+    }
+    if (done < atomic_load_explicit(&epoch->tasks, memory_order_relaxed)) {
+        return false;
+    }
+
+    for (int w = 0; w < cp->num_workers; w++) {
+        checkpoint_slot *slot = &cp->slots[(size_t) w * CHECKPOINT_SLOTS + e % CHECKPOINT_SLOTS];
+        accumulatorMerge(&cp->total, &slot->partial);
+        accumulatorReset(&slot->partial);
+        atomic_store_explicit(&slot->done, 0, memory_order_relaxed);
+    }
+    cp->records_done = atomic_load_explicit(&epoch->end_record, memory_order_relaxed);
+    atomic_store_explicit(&epoch->tasks, 0, memory_order_relaxed);
+    // hands the slots back to the master for epoch e + CHECKPOINT_SLOTS
+    atomic_store_explicit(&cp->completed, e + 1, memory_order_release);
+    return true;
+}
+
+/*
+ * fsync the directory holding path, so that a rename in it is on disk too
+ */
+static int syncParent(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char *dir = slash == NULL ? strdup(".") : strndup(path, slash == path ? 1 : (size_t) (slash - path));
+    int status = -1;
+
+    if (dir == NULL) {
+        perror("checkpoint");
+        return -1;
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || fsync(fd) != 0) {
+        perror(dir);
+    } else {
+        status = 0;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(dir);
+    return status;
+}
+
+/*
+ * write the total to a temporary file and rename it over the checkpoint,
+ * so a crash leaves either the old checkpoint or the new one
+ */
+static int writeCheckpoint(checkpointer *cp)
+{
+    size_t state_size = accumulatorStateSize(&cp->total);
+    size_t size = CHECKPOINT_HEADER_SIZE + state_size;
+    size_t path_length = strlen(cp->path);
+    char *temp = malloc(path_length + 5);
+    unsigned char *data = malloc(size);
+    int status = -1;
+
+    if (temp == NULL || data == NULL) {
+        perror("checkpoint");
+        goto out;
+    }
+    memcpy(temp, cp->path, path_length);
+    memcpy(temp + path_length, ".tmp", 5);
+    memcpy(data, CHECKPOINT_MAGIC, 4);
+    storeLe32(data + 4, CHECKPOINT_VERSION);
+    storeLe64(data + 8, cp->records_done);
+    storeLe64(data + 16, cp->input_size);
+    storeLe32(data + 24, (uint32_t) state_size);
+    accumulatorSave(&cp->total, data + CHECKPOINT_HEADER_SIZE);
+
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(temp);
+        goto out;
+    }
+    ssize_t written = write(fd, data, size);
+    if (written != (ssize_t) size || fsync(fd) != 0) {
+        perror(temp);
+        close(fd);
+        goto out;
+    }
+    close(fd);
+    if (rename(temp, cp->path) != 0) {
+        perror(cp->path);
+        goto out;
+    }
+    // the rename lives in the directory: without this a crash may undo it
+    status = syncParent(cp->path);
+
+out:
+    free(temp);
+    free(data);
+    return status;
+}
+
+int checkpointRun(checkpointer *cp)
+{
+    struct timespec pause = { 0, CHECKPOINT_POLL_NS };
+
+    for (;;) {
+        // read before folding: if the master was finished, whatever it sealed is visible
+        bool finished = atomic_load_explicit(&cp->finished, memory_order_acquire);
+        bool folded = false;
+        while (foldEpoch(cp)) {
+            folded = true;
+        }
+        if (folded && writeCheckpoint(cp) != 0) {
+            return -1;
+        }
+        if (finished && atomic_load_explicit(&cp->completed, memory_order_relaxed)
+                        == atomic_load_explicit(&cp->sealed_epochs, memory_order_relaxed)) {
+            return 0;
+        }
+        if (!folded) {
+            nanosleep(&pause, NULL);
+        }
+    }
+}
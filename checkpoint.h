@@ -0,0 +1,88 @@
+/*
+ * checkpoint.h
+ *
+ * Crash-consistent progress files for long runs. The master cuts the input
+ * into epochs of consecutive records and tags every task with its epoch;
+ * workers add a task's value to a per-worker slot of that epoch and count it
+ * done. A checkpointer thread waits until every task of the oldest open
+ * epoch is done, folds the slots into the running total and writes
+ *
+ *   "MWCK", u32 version, u64 records completed, u64 input size,
+ *   u32 state size, raw accumulator states
+ *
+ * to PATH.tmp before renaming it over PATH. Nobody ever stops: workers only
+ * touch their own slots and the master only waits when CHECKPOINT_SLOTS
+ * epochs are still unfinished.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aggregate.h"
+#include "cache_line.h"
+
+/* epochs in flight at once; also the number of slots per worker */
+#define CHECKPOINT_SLOTS 8
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t done; /* finished tasks of the slot's epoch */
+    accumulator partial;
+} checkpoint_slot;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t tasks; /* published so far */
+    atomic_uint_fast64_t end_record;                      /* records consumed once it is sealed */
+} checkpoint_epoch;
+
+typedef struct {
+    const char *path;
+    size_t input_size;
+    int num_workers;
+    checkpoint_slot *slots;               /* CHECKPOINT_SLOTS per worker */
+    checkpoint_epoch epochs[CHECKPOINT_SLOTS];
+    accumulator total;                    /* every completed epoch, checkpointer only */
+    uint64_t records_done;                /* records covered by total */
+    /* master only */
+    uint64_t open_epoch;
+    bool epoch_open;
+    uint64_t records;                     /* consumed so far, skipped ones included */
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t completed; /* epochs folded into total */
+    atomic_uint_fast64_t sealed_epochs;
+    atomic_bool finished;                 /* the master sealed its last epoch */
+} checkpointer;
+
+/*
+ * returns 0 on success, -1 on allocation failure
+ */
+int checkpointInit(checkpointer *cp, const char *path, size_t input_size, int num_workers,
+                   const aggregate_ops *const *ops, size_t count);
+void checkpointDestroy(checkpointer *cp);
+
+/*
+ * load the checkpoint at cp->path into the total
+ * returns how many input records it covers, or -1 after printing why it cannot be used
+ */
+long long checkpointLoad(checkpointer *cp);
+
+/* master: a record was consumed; returns the epoch a task record belongs to */
+uint64_t checkpointRecord(checkpointer *cp, bool is_task);
+/* master: close the open epoch, if any; the next record opens another one */
+void checkpointSeal(checkpointer *cp);
+/* master: seal and tell the checkpointer no more records will come */
+void checkpointFinish(checkpointer *cp);
+
+/* worker (0-based): a task of the given epoch finished */
+void checkpointAdd(checkpointer *cp, int worker, uint64_t epoch, long value);
+
+/*
+ * checkpointer thread: write a checkpoint whenever an epoch completes, until
+ * the master finished and all epochs did; returns 0, or -1 after printing why
+ */
+int checkpointRun(checkpointer *cp);
+
+#endif
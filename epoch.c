@@ -0,0 +1,117 @@
+/*
+ * epoch.c
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "epoch.h"
+
+int epochInit(epoch_domain *domain, int num_participants)
+{
+    domain->participants = aligned_alloc(CACHE_LINE_SIZE, num_participants * sizeof(epoch_participant));
+    if (domain->participants == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < num_participants; i++) {
+        epoch_participant *p = &domain->participants[i];
+        atomic_init(&p->state, 0);
+        for (int j = 0; j < EPOCH_LIMBO_LISTS; j++) {
+            p->limbo[j] = NULL;
+            p->limbo_epoch[j] = 0;
+        }
+        p->pending = 0;
+    }
+    domain->num_participants = num_participants;
+    atomic_init(&domain->global, 0);
+    return 0;
+}
+
+/* returns how many blocks were freed */
+static size_t freeList(epoch_node *node)
+{
+    size_t count = 0;
+    while (node != NULL) {
+        epoch_node *next = node->next;
+        free(node);
+        node = next;
+        count++;
+    }
+    return count;
+}
+
+void epochDestroy(epoch_domain *domain)
+{
+    for (int i = 0; i < domain->num_participants; i++) {
+        for (int j = 0; j < EPOCH_LIMBO_LISTS; j++) {
+            freeList(domain->participants[i].limbo[j]);
+        }
+    }
+    free(domain->participants);
+    domain->participants = NULL;
+}
+
+void epochEnter(epoch_domain *domain, int participant)
+{
+    uint64_t epoch = atomic_load_explicit(&domain->global, memory_order_relaxed);
+    // seq_cst so the announcement is visible before any shared pointer is read
+    atomic_store(&domain->participants[participant].state, epoch << 1 | 1);
+}
+
+void epochExit(epoch_domain *domain, int participant)
+{
+    atomic_store_explicit(&domain->participants[participant].state, 0, memory_order_release);
+}
+
+/*
+ * free the lists retired at least two epochs before the given one
+ */
+static void freeSafe(epoch_participant *p, uint64_t global)
+{
+    for (int j = 0; j < EPOCH_LIMBO_LISTS; j++) {
+        if (p->limbo[j] != NULL && p->limbo_epoch[j] + 2 <= global) {
+            p->pending -= freeList(p->limbo[j]);
+            p->limbo[j] = NULL;
+        }
+    }
+}
+
+void epochRetire(epoch_domain *domain, int participant, epoch_node *block)
+{
+    epoch_participant *p = &domain->participants[participant];
+    uint64_t epoch = atomic_load(&domain->global);
+    int slot = (int) (epoch % EPOCH_LIMBO_LISTS);
+
+    if (p->limbo[slot] != NULL && p->limbo_epoch[slot] != epoch) {
+        // left over from three or more epochs ago
+        freeSafe(p, epoch);
+    }
+    block->next = p->limbo[slot];
+    p->limbo[slot] = block;
+    p->limbo_epoch[slot] = epoch;
+    p->pending++;
+    epochCollect(domain, participant);
+}
+
+void epochCollect(epoch_domain *domain, int participant)
+{
+    epoch_participant *p = &domain->participants[participant];
+    uint64_t global = atomic_load(&domain->global);
+    bool all_caught_up = true;
+
+    if (p->pending == 0) {
+        return;
+    }
+    for (int i = 0; i < domain->num_participants; i++) {
+        uint64_t state = atomic_load(&domain->participants[i].state);
+        if ((state & 1) && (state >> 1) != global) {
+            all_caught_up = false;
+            break;
+        }
+    }
+    if (all_caught_up) {
+        atomic_compare_exchange_strong(&domain->global, &global, global + 1);
+        global = atomic_load(&domain->global);
+    }
+    freeSafe(p, global);
+}
@@ -0,0 +1,56 @@
+/*
+ * epoch.h
+ *
+ * Epoch-based reclamation for memory that lock-free readers may still be
+ * looking at. Readers bracket their accesses with epochEnter/epochExit;
+ * writers hand unlinked blocks to epochRetire and they are freed once every
+ * participant has moved two epochs past the retirement.
+ */
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache_line.h"
+
+/* must be the first member of a retirable block, which is released with free() */
+typedef struct epoch_node epoch_node;
+
+struct epoch_node {
+    epoch_node *next;
+};
+
+#define EPOCH_LIMBO_LISTS 3
+
+typedef struct {
+    /* (epoch << 1) | 1 while inside a critical section, 0 outside */
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t state;
+    /* owner only: blocks retired during limbo_epoch[i] */
+    epoch_node *limbo[EPOCH_LIMBO_LISTS];
+    uint64_t limbo_epoch[EPOCH_LIMBO_LISTS];
+    size_t pending;
+} epoch_participant;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t global;
+    int num_participants;
+    epoch_participant *participants;
+} epoch_domain;
+
+/* returns 0 on success, -1 on allocation failure */
+int epochInit(epoch_domain *domain, int num_participants);
+/* frees everything still in limbo; no participant may be active */
+void epochDestroy(epoch_domain *domain);
+
+void epochEnter(epoch_domain *domain, int participant);
+void epochExit(epoch_domain *domain, int participant);
+
+/* queue a block that no new reader can reach any more */
+void epochRetire(epoch_domain *domain, int participant, epoch_node *block);
+/* try to advance the global epoch and free the participant's safe blocks */
+void epochCollect(epoch_domain *domain, int participant);
+
+#endif
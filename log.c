@@ -0,0 +1,151 @@
+/*
+ * log.c
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "log.h"
+#include "stats.h"
+
+/* how long an idle writer sleeps before looking at the rings again */
+#define LOG_POLL_NS 1000000L
+
+log_level log_threshold = LOG_INFO;
+
+static log_ring *rings;
+static int num_log_rings;
+static uint64_t log_start;
+static atomic_bool stopping;
+static pthread_t writer;
+static _Thread_local log_ring *own_ring;
+
+void logAttach(int index)
+{
+    own_ring = index >= 0 && index < num_log_rings ? &rings[index] : NULL;
+}
+
+void logPush(const char *format, long arg0, long arg1)
+{
+    log_ring *ring = own_ring;
+    if (ring == NULL) {
+        return; // not a logging thread, or logInit failed
+    }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == LOG_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring->records[tail % LOG_RING_CAPACITY] = (log_record) {
+        .at_ns = statsNowNs(),
+        .format = format,
+        .args = { arg0, arg1 },
+    };
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/*
+ * format the oldest record over all rings
+ * returns false when every ring is empty
+ */
+static bool writeOldest(void)
+{
+    log_ring *oldest = NULL;
+    const log_record *record = NULL;
+    for (int i = 0; i < num_log_rings; i++) {
+        log_ring *ring = &rings[i];
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            continue;
+        }
+        const log_record *r = &ring->records[head % LOG_RING_CAPACITY];
+        if (record == NULL || r->at_ns < record->at_ns) {
+            oldest = ring;
+            record = r;
+        }
+    }
+    if (record == NULL) {
+        return false;
+    }
+    uint64_t at = record->at_ns > log_start ? record->at_ns - log_start : 0;
+    fprintf(stdout, "[%3llu.%06llu] ", (unsigned long long) (at / 1000000000u),
+            (unsigned long long) (at % 1000000000u / 1000u));
+    fprintf(stdout, record->format, record->args[0], record->args[1]);
+    fputc('\n', stdout);
+    atomic_fetch_add_explicit(&oldest->head, 1, memory_order_release);
+    return true;
+}
+
+static void * threadStartWriter(void *arg) {
+    struct timespec pause = { 0, LOG_POLL_NS };
+    (void) arg;
+
+    for (;;) {
+        // read before draining: once it is set, nothing is logged anymore
+        bool stop = atomic_load_explicit(&stopping, memory_order_acquire);
+        bool wrote = false;
+        while (writeOldest()) {
+            wrote = true;
+        }
+        if (stop) {
+            break;
+        }
+        if (!wrote) {
+            fflush(stdout);
+            nanosleep(&pause, NULL);
+        }
+    }
+    fflush(stdout);
+    return NULL;
+}
+
+int logInit(int num_rings)
+{
+    log_start = statsNowNs();
+    if (log_threshold == LOG_QUIET) {
+        return 0; // nothing will ever be pushed
+    }
+    rings = aligned_alloc(CACHE_LINE_SIZE, (size_t) num_rings * sizeof(log_ring));
+    if (rings == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < num_rings; i++) {
+        atomic_init(&rings[i].tail, 0);
+        atomic_init(&rings[i].dropped, 0);
+        atomic_init(&rings[i].head, 0);
+    }
+    num_log_rings = num_rings;
+    atomic_init(&stopping, false);
+    int s = pthread_create(&writer, NULL, &threadStartWriter, NULL);
+    if (s != 0) {
+        free(rings);
+        rings = NULL;
+        num_log_rings = 0;
+        errno = s;
+        return -1;
+    }
+    return 0;
+}
+
+void logShutdown(void)
+{
+    if (rings == NULL) {
+        return;
+    }
+    atomic_store_explicit(&stopping, true, memory_order_release);
+    pthread_join(writer, NULL);
+
+    size_t dropped = 0;
+    for (int i = 0; i < num_log_rings; i++) {
+        dropped += atomic_load_explicit(&rings[i].dropped, memory_order_relaxed);
+    }
+    if (dropped > 0) {
+        fprintf(stderr, "log: %zu records dropped, the writer fell behind\n", dropped);
+    }
+    free(rings);
+    rings = NULL;
+    num_log_rings = 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * log.h
+ *
+ * Asynchronous logging that keeps stdio off the hot path. Every thread owns
+ * a single-producer ring of binary records (timestamp, format string, two
+ * arguments) and one writer thread formats them onto stdout, oldest first.
+ * A message below the current level costs one compare and nothing is
+ * formatted by the thread that logs it; a full ring drops the record.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache_line.h"
+
+typedef enum {
+    LOG_QUIET,      /* -q: nothing */
+    LOG_INFO,       /* default: rare events such as workers joining or leaving */
+    LOG_VERBOSE,    /* -v: every task and every wait */
+} log_level;
+
+#define LOG_RING_CAPACITY 1024
+
+typedef struct {
+    uint64_t at_ns;
+    const char *format;   /* printf format taking two longs, without the newline */
+    long args[2];
+} log_record;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; /* next record to write, producer only */
+    atomic_size_t dropped;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head; /* next record to format, writer only */
+    log_record records[LOG_RING_CAPACITY];
+} log_ring;
+
+/* set before any thread logs */
+extern log_level log_threshold;
+
+/*
+ * set up rings for threads 0 to num_rings - 1 and start the writer thread
+ * returns 0 on success, -1 with errno set otherwise
+ */
+int logInit(int num_rings);
+/* format everything logged so far, stop the writer and report dropped records on stderr */
+void logShutdown(void);
+
+/* the calling thread logs to ring index from now on */
+void logAttach(int index);
+
+void logPush(const char *format, long arg0, long arg1);
+
+/* format must be a string literal: only its address is recorded */
+#define logEvent(level, format, arg0, arg1) \
+    do { \
+        if ((level) <= log_threshold) { \
+            logPush((format), (long) (arg0), (long) (arg1)); \
+        } \
+    } while (0)
+
+#endif
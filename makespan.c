@@ -0,0 +1,118 @@
+/*
+ * makespan.c
+ */
+
+#include <stdlib.h>
+
+#include "makespan.h"
+
+/*
+ * binary heaps of longs; max-heap when sign is 1, min-heap when it is -1
+ */
+static void heapPush(long *heap, size_t *size, long value, long sign)
+{
+    size_t i = (*size)++;
+    while (i > 0 && sign * heap[(i - 1) / 2] < sign * value) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = value;
+}
+
+static long heapPop(long *heap, size_t *size, long sign)
+{
+    long top = heap[0];
+    long last = heap[--(*size)];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= *size) {
+            break;
+        }
+        if (child + 1 < *size && sign * heap[child + 1] > sign * heap[child]) {
+            child++;
+        }
+        if (sign * heap[child] <= sign * last) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+int makespanInit(makespan_sim *sim, int num_workers, bool longest_first)
+{
+    sim->longest_first = longest_first;
+    sim->free_at = malloc(num_workers * sizeof(long));
+    sim->ready = longest_first ? malloc(MAKESPAN_WINDOW * sizeof(long)) : NULL;
+    sim->num_workers = 0;
+    sim->num_ready = 0;
+    sim->ready_release = 0;
+    sim->makespan = 0;
+    sim->overflowed = false;
+    if (sim->free_at == NULL || (longest_first && sim->ready == NULL)) {
+        makespanDestroy(sim);
+        return -1;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        heapPush(sim->free_at, &sim->num_workers, 0, -1);
+    }
+    return 0;
+}
+
+void makespanDestroy(makespan_sim *sim)
+{
+    free(sim->free_at);
+    free(sim->ready);
+    sim->free_at = NULL;
+    sim->ready = NULL;
+}
+
+/*
+ * the next idle worker runs a task of the given duration, once it is released
+ */
+static void startTask(makespan_sim *sim, long release, long value)
+{
+    long now = heapPop(sim->free_at, &sim->num_workers, -1);
+    if (release > now) {
+        now = release;
+    }
+    long end = now + (value > 0 ? value : 0);
+    if (end > sim->makespan) {
+        sim->makespan = end;
+    }
+    heapPush(sim->free_at, &sim->num_workers, end, -1);
+}
+
+static void startLongest(makespan_sim *sim)
+{
+    startTask(sim, sim->ready_release, heapPop(sim->ready, &sim->num_ready, 1));
+}
+
+void makespanAdd(makespan_sim *sim, long release, long value)
+{
+    if (!sim->longest_first) {
+        startTask(sim, release, value); // the oldest task, as soon as both it and a worker are there
+        return;
+    }
+    // workers idle before this release choose among what was released so far
+    while (sim->num_ready > 0 && sim->free_at[0] < release) {
+        startLongest(sim);
+    }
+    if (sim->num_ready == MAKESPAN_WINDOW) {
+        startLongest(sim);
+        sim->overflowed = true;
+    }
+    heapPush(sim->ready, &sim->num_ready, value, 1);
+    sim->ready_release = release;
+}
+
+long makespanFinish(makespan_sim *sim)
+{
+    while (sim->longest_first && sim->num_ready > 0) {
+        startLongest(sim);
+    }
+    return sim->makespan;
+}
@@ -0,0 +1,42 @@
+/*
+ * makespan.h
+ *
+ * Online estimate of a run on identical workers, to compare dispatch orders.
+ * Every task has a release time (the waits before it) and a duration (its
+ * value); an idle worker takes a released task at once, in arrival order
+ * for fifo or longest first for lpt. Times are in task value units.
+ * Tasks are fed as they are published, so memory does not grow with the
+ * input: fifo needs one entry per worker, lpt also keeps up to
+ * MAKESPAN_WINDOW released tasks that have not started. When more are
+ * waiting, the longest one starts early and the lpt figure is approximate.
+ */
+
+#ifndef MAKESPAN_H
+#define MAKESPAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAKESPAN_WINDOW 65536
+
+typedef struct {
+    bool longest_first;
+    long *free_at;        /* min-heap of when each worker is idle */
+    size_t num_workers;
+    long *ready;          /* lpt: max-heap of released durations not started yet */
+    size_t num_ready;
+    long ready_release;   /* lpt: release of the latest ready task */
+    long makespan;
+    bool overflowed;      /* lpt: the window was full at least once */
+} makespan_sim;
+
+/* returns 0 on success, -1 on allocation failure */
+int makespanInit(makespan_sim *sim, int num_workers, bool longest_first);
+void makespanDestroy(makespan_sim *sim);
+
+/* add the next task; releases must not decrease */
+void makespanAdd(makespan_sim *sim, long release, long value);
+/* time at which the last task added finishes */
+long makespanFinish(makespan_sim *sim);
+
+#endif
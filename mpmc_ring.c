@@ -0,0 +1,156 @@
+/*
+ * mpmc_ring.c
+ */
+
+#include <stdint.h>
+
+#include "affinity.h"
+#include "mpmc_ring.h"
+
+_Thread_local unsigned long mpmc_contention;
+
+int mpmcRingInitOnNode(mpmc_ring *ring, size_t capacity, int node)
+{
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ring->slots = affinityAlloc(size * sizeof(mpmc_slot), node);
+    if (ring->slots == NULL) {
+        return -1;
+    }
+    ring->node = node;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&ring->slots[i].sequence, i);
+    }
+    ring->mask = size - 1;
+    ring->limit = capacity > 0 ? capacity : 1;
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->closed, false);
+    return 0;
+}
+
+void mpmcRingDestroy(mpmc_ring *ring)
+{
+    affinityFree(ring->slots, (ring->mask + 1) * sizeof(mpmc_slot), ring->node);
+    ring->slots = NULL;
+}
+
+bool mpmcRingTryPush(mpmc_ring *ring, const task *item)
+{
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for (;;) {
+        mpmc_slot *slot = &ring->slots[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+        if (diff == 0) {
+            // a rounded-up ring has free slots past the limit; the head only
+            // moves on, so this never lets more than limit tasks in
+            if (ring->limit <= ring->mask
+                && pos - atomic_load_explicit(&ring->head, memory_order_relaxed) >= ring->limit) {
+                return false;
+            }
+            // slot is free for this position, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->item = *item;
+                atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+                return true;
+            }
+            mpmc_contention++;
+        } else if (diff < 0) {
+            // slot still holds a task from the previous lap: full
+            return false;
+        } else {
+            mpmc_contention++;
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+}
+
+bool mpmcRingTryPop(mpmc_ring *ring, task *item)
+{
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (;;) {
+        mpmc_slot *slot = &ring->slots[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+        if (diff == 0) {
+            // slot holds a published task, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *item = slot->item;
+                // hand the slot back to producers one lap ahead
+                atomic_store_explicit(&slot->sequence, pos + ring->mask + 1, memory_order_release);
+                return true;
+            }
+            mpmc_contention++;
+        } else if (diff < 0) {
+            // nothing published at this position yet: empty
+            return false;
+        } else {
+            mpmc_contention++;
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+}
+
+size_t mpmcRingTryPopBatch(mpmc_ring *ring, task *items, size_t max)
+{
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (;;) {
+        size_t count = 0;
+
+        // count the published slots from the head on
+        while (count < max) {
+            size_t seq = atomic_load_explicit(&ring->slots[(pos + count) & ring->mask].sequence,
+                                              memory_order_acquire);
+            if (seq != pos + count + 1) {
+                break;
+            }
+            count++;
+        }
+        if (count == 0) {
+            size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+            if (head == pos) {
+                return 0;
+            }
+            mpmc_contention++;
+            pos = head; // another consumer moved on, look again
+            continue;
+        }
+
+        // claim them all at once; a failure reloads pos and retries
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + count,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            for (size_t i = 0; i < count; i++) {
+                mpmc_slot *slot = &ring->slots[(pos + i) & ring->mask];
+                items[i] = slot->item;
+                atomic_store_explicit(&slot->sequence, pos + i + ring->mask + 1, memory_order_release);
+            }
+            return count;
+        }
+        mpmc_contention++;
+    }
+}
+
+size_t mpmcRingSize(mpmc_ring *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
+
+void mpmcRingClose(mpmc_ring *ring)
+{
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+bool mpmcRingIsClosed(mpmc_ring *ring)
+{
+    return atomic_load_explicit(&ring->closed, memory_order_acquire);
+}
@@ -0,0 +1,64 @@
+/*
+ * mpmc_ring.h
+ *
+ * Bounded lock-free multi-producer/multi-consumer ring of tasks.
+ * Every slot carries a sequence number telling whether it is ready to be
+ * written (sequence == position) or read (sequence == position + 1), so a
+ * push or pop costs one CAS on the shared index plus one store on the slot.
+ */
+
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache_line.h"
+#include "task.h"
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t sequence;
+    task item;
+} mpmc_slot;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; /* next position to push */
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head; /* next position to pop */
+    _Alignas(CACHE_LINE_SIZE) atomic_bool closed; /* no more pushes will happen */
+    size_t mask;
+    size_t limit;         /* most tasks queued at once, at most mask + 1 */
+    mpmc_slot *slots;
+    int node;             /* NUMA node of the slots, -1 for any */
+} mpmc_ring;
+
+/* per-thread count of lost races (failed CAS or slot taken by another thread) */
+extern _Thread_local unsigned long mpmc_contention;
+
+/*
+ * allocate a ring holding capacity tasks (at least 1), with the slots placed
+ * on a NUMA node (-1 for any); the slot count is rounded up to a power of two
+ * but pushes fail once capacity tasks are queued
+ * returns 0 on success, -1 if the slots could not be allocated
+ */
+int mpmcRingInitOnNode(mpmc_ring *ring, size_t capacity, int node);
+void mpmcRingDestroy(mpmc_ring *ring);
+
+/* returns false when the ring is full */
+bool mpmcRingTryPush(mpmc_ring *ring, const task *item);
+/* returns false when the ring is empty */
+bool mpmcRingTryPop(mpmc_ring *ring, task *item);
+
+/*
+ * claim up to max consecutive published tasks with a single CAS
+ * returns how many were copied into items, 0 when the ring is empty
+ */
+size_t mpmcRingTryPopBatch(mpmc_ring *ring, task *items, size_t max);
+/* number of queued tasks; only a hint while other threads are active */
+size_t mpmcRingSize(mpmc_ring *ring);
+
+/* mark that the producers are done; pending tasks can still be popped */
+void mpmcRingClose(mpmc_ring *ring);
+bool mpmcRingIsClosed(mpmc_ring *ring);
+
+#endif
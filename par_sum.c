@@ -1,5 +1,7 @@
+#define _GNU_SOURCE // pthread_attr_setaffinity_np
 #include <stdio.h>
 #include <unistd.h> // getopt lib
+#include <getopt.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +9,23 @@
 #include <math.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <sched.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <glob.h>
+
+#include "affinity.h"
+#include "aggregate.h"
+#include "async_exec.h"
+#include "checkpoint.h"
+#include "log.h"
+#include "makespan.h"
+#include "parking.h"
+#include "remote.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "task_kernel.h"
+#include "task_reader.h"
 
 #define handleErrorNumber(error_num, msg) \
 do { errno = error_num; perror(msg); exit(EXIT_FAILURE); } while (0)
@@ -14,176 +33,642 @@ do { errno = error_num; perror(msg); exit(EXIT_FAILURE); } while (0)
 #define handleError(msg) \
 do { perror(msg); exit(EXIT_FAILURE); } while (0)
 
+/* life cycle of a thread slot; the elastic pool reuses retired ones */
+enum { SLOT_IDLE, SLOT_RUNNING, SLOT_RETIRED };
+
+/* tasks parsed ahead while the master waits for a release time */
+#define STAGE_CAPACITY 4096
+
+/* one per input file, streamed by its own master thread with its own wait timing */
+typedef struct {
+    task_reader input;
+    long stage[STAGE_CAPACITY];
+    long trace_release; /* lpt: seconds of waits read so far */
+} producer;
+
 typedef struct {
     pthread_t thread_id;
     int thread_num;
+    producer *source; /* masters: the input they stream */
+    atomic_int state; /* SLOT_*, joinable unless idle */
+    bool initialized; /* partial and context allocated by an earlier incarnation */
+    accumulator partial; /* private aggregates of a worker */
+    kernel_context context; /* scratch state of the task kernel */
+    task batch[SCHEDULE_MAX_CHUNK]; /* tasks claimed but not started yet */
+    size_t batch_size, batch_next;
+    thread_stats stats;
 } thread_info;
 
-typedef struct node node;
-
-struct node {
-    int value;
-    node* next;
-};
+/* Global variables */
+producer *producers;
+int num_inputs;
+atomic_int producers_left; /* the last master to finish closes the queues */
+scheduler task_scheduler;
+task_kernel kernel;
+parking_lot parking; /* idle workers wait here for the master's tasks */
+parking_lot room;    /* masters wait here while the queues are full */
+bool async_mode = false; /* workers run tasks as timers in event loops */
+async_doorbell doorbell;
 
-typedef struct {
-    int value;
-    char instruction_type[1];
-} instruction;
+/* --checkpoint: progress written every checkpoint_every records and at every wait */
+bool checkpointing = false;
+checkpointer checkpoints;
+uint64_t checkpoint_every = 10000;
+uint64_t epoch_records;  /* master: records in the open epoch */
+long long resume_records; /* master: records already covered by the loaded checkpoint */
 
-/* Global variables */
-int file_size = 0;
-instruction* task_list;
-node *instruction_linked_list, *last_node, *current_node;
-pthread_mutex_t lock_last_node, lock_linked_list, lock_current_node, lock_finished;
-pthread_mutex_t lock_numbers;
-pthread_cond_t cond_current_note;
-bool finished_inserting_on_linked_list = false;
-
-long sum = 0;
-long odd = 0;
-long min = INT_MAX;
-long max = INT_MIN;
+/* --no-simulate: every process value read up front, split evenly over the workers */
+bool no_simulate = false;
+long *values;
+size_t num_values;
+bool stats_enabled = false;
 bool done = false;
+affinity_plan plan;
+bool pinned = false;
+
+/* elastic pool: between elastic_min and elastic_max workers, resized by the controller */
+bool elastic = false;
+int elastic_min, elastic_max;
+atomic_int active_workers;
+_Atomic uint64_t recent_latency_ns; /* enqueue-to-start latency of the last task started */
+thread_info *threads;
+uint64_t run_start;
+
+#define ELASTIC_TICK_NS 5000000L            /* how often the controller looks at the queues */
+#define ELASTIC_BACKLOG_PER_WORKER 4        /* spawn when more tasks than this wait per worker */
+#define ELASTIC_LATENCY_NS 1000000u         /* or when tasks wait longer than this to start */
+#define ELASTIC_IDLE_NS 100000000u          /* retire after this long without a task */
+#define SCALE_LOG_CAPACITY 4096
+
+scale_event scale_log[SCALE_LOG_CAPACITY];
+atomic_size_t scale_events;
+
+/* reductions computed by every worker and merged after the join */
+const aggregate_ops *aggregates[AGGREGATE_MAX] = { &basic_aggregate };
+size_t num_aggregates = 1;
+
+#define TASK_QUEUE_CAPACITY 1024
+/* longest a master parked on full queues sleeps before looking again */
+#define QUEUE_PARK_NS 1000000u
+/* first interval between --stats queue occupancy samples */
+#define OCCUPANCY_INTERVAL_NS 1000000u
+
+size_t queue_capacity = TASK_QUEUE_CAPACITY;
+occupancy_log occupancy;
+
+/* lpt mode, single input: the same tasks as published, on fifo and lpt models of the workers */
+makespan_sim fifo_makespan, lpt_makespan;
 
 // function prototypes
-void update(long number);
+void update(thread_info *t_info, const task *item);
 
 /*
- * update global aggregate variables given a number
+ * update the worker's private aggregates given a task
  */
-void update(long number)
+void update(thread_info *t_info, const task *item)
 {
     // simulate computation
-    sleep(number);
+    taskKernelRun(&kernel, &t_info->context, item->value);
 
-    pthread_mutex_lock(&lock_numbers);
-    // update aggregate variables
-    sum += number;
-    if (number % 2 == 1) {
-        odd++;
+    // update aggregate variables, in the task's checkpoint epoch if there are checkpoints
+    if (checkpointing) {
+        checkpointAdd(&checkpoints, t_info->thread_num - 2, item->epoch, item->value);
+    } else {
+        accumulatorAdd(&t_info->partial, item->value);
     }
-    if (number < min) {
-        min = number;
+}
+
+/*
+ * whether the parked master should try to push again
+ */
+static bool queueHasRoom(void *arg) {
+    return schedulerHasRoom(arg);
+}
+
+/*
+ * --checkpoint: count a consumed record in the open epoch, sealing it once it is full
+ * returns the epoch of the record
+ */
+static uint64_t countRecord(bool is_task) {
+    uint64_t epoch = checkpointRecord(&checkpoints, is_task);
+    if (++epoch_records >= checkpoint_every) {
+        checkpointSeal(&checkpoints);
+        epoch_records = 0;
+    }
+    return epoch;
+}
+
+/*
+ * push a task, backing off while the queues are full
+ */
+static void publish(thread_info *t_info, long value) {
+    task new_task = { .value = value };
+    unsigned attempt = 0;
+    if (checkpointing) {
+        new_task.epoch = countRecord(true);
+    }
+    if (task_scheduler.mode == SCHEDULE_LPT && num_inputs == 1) {
+        makespanAdd(&fifo_makespan, t_info->source->trace_release, value);
+        makespanAdd(&lpt_makespan, t_info->source->trace_release, value);
+    }
+    if (stats_enabled || elastic) {
+        new_task.enqueued_ns = statsNowNs();
+    }
+    while (!schedulerTryPush(&task_scheduler, &new_task)) { // queues full, let workers drain them
+        if (stats_enabled && attempt == 0) {
+            t_info->stats.waits++;
+        }
+        attempt++;
+        // spin, then park until a worker claims tasks; the timeout covers
+        // the async loops and worker processes, which do not wake us
+        parkingWait(&room, (int) (t_info->source - producers), queueHasRoom, &task_scheduler, QUEUE_PARK_NS);
     }
-    if (number > max) {
-        max = number;
+    if (stats_enabled) {
+        if (attempt > 0) {
+            t_info->stats.backoff_ns += statsNowNs() - new_task.enqueued_ns;
+        }
+        t_info->stats.tasks++;
+    }
+    // one task, one worker taken out of the parking lot (if any is there)
+    t_info->stats.parks += parkingWake(&parking, 1);
+    if (async_mode) {
+        asyncDoorbellRing(&doorbell);
+    }
+    logEvent(LOG_VERBOSE, "New job available!", 0, 0);
+}
+
+/*
+ * sleep until an absolute CLOCK_MONOTONIC time, returning how late we woke up
+ */
+static uint64_t sleepUntil(uint64_t deadline_ns) {
+    struct timespec deadline = {
+        .tv_sec = (time_t) (deadline_ns / 1000000000u),
+        .tv_nsec = (long) (deadline_ns % 1000000000u),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        // interrupted by a signal: the deadline has not moved
     }
-    pthread_mutex_unlock(&lock_numbers);
+    uint64_t now = statsNowNs();
+    return now > deadline_ns ? now - deadline_ns : 0;
 }
 
 static void * threadStartMaster(void *arg) {
     thread_info *t_info = arg;
+    producer *source = t_info->source;
+    logAttach(t_info->thread_num);
     // printf("Thread mestre! num %d\n", t_info->thread_num);
-    instruction_linked_list = malloc(sizeof(node));
-    instruction_linked_list->next = NULL;
-    instruction_linked_list->value = -1;
-    last_node = instruction_linked_list;
-    
-    for (int i = 0; i < file_size; ++i) {
-        if(strcmp(task_list[i].instruction_type, "e") == 0) {
-            // printf("Sleeping for %d seconds!\n", task_list[i].value);
-            sleep(task_list[i].value);
-            // printf("Waked up!\n");
-        } else {
-            if(instruction_linked_list->next != NULL) { // linked list already initialized
-                node *new_node = malloc(sizeof(node));
-
-                pthread_mutex_lock(&lock_last_node); // LOCK last node
-                last_node->next = new_node;
-                last_node->next->value = task_list[i].value;
-                last_node->next->next = NULL;
-                last_node = last_node->next;
-                pthread_mutex_unlock(&lock_last_node); // UNLOCK last node
-
-                pthread_mutex_lock(&lock_current_node); // LOCK current node
-                if(current_node == NULL) {
-                    current_node = last_node;
-                }
-                pthread_mutex_unlock(&lock_current_node); // UNLOCK current node
 
-                printf("New job available!\n");
-                pthread_cond_signal(&cond_current_note);
-            } else {
-                node *new_node = malloc(sizeof(node));
+    task_record record;
+    int status = 0;
+    bool lookahead = false; // record already read but not handled yet
+    size_t staged = 0;
+    uint64_t start = statsNowNs();
+    uint64_t release = start; // when the tasks read so far may run
 
-                pthread_mutex_lock(&lock_linked_list); // LOCK linked list
-                instruction_linked_list->next = new_node;
-                instruction_linked_list->next->value = task_list[i].value;
-                instruction_linked_list->next->next = NULL;
-                pthread_mutex_unlock(&lock_linked_list); // UNLOCK linked list
+    // --resume: what the checkpoint covers was done by an earlier run
+    for (long long skipped = 0; skipped < resume_records; skipped++) {
+        if ((status = taskReaderNext(&source->input, &record)) <= 0) {
+            fprintf(stderr, "Checkpoint covers more records than the input has\n");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-                pthread_mutex_lock(&lock_last_node); // LOCK last node
-                last_node = new_node;
-                pthread_mutex_unlock(&lock_last_node); // UNLOCK last node
+    // parse and enqueue as we read, so workers start on the first record
+    while (lookahead || (status = taskReaderNext(&source->input, &record)) > 0) {
+        lookahead = false;
+        if (record.op != TASK_WAIT) {
+            publish(t_info, record.value);
+            continue;
+        }
 
-                pthread_mutex_lock(&lock_current_node); // LOCK current node
-                current_node = new_node;
-                pthread_mutex_unlock(&lock_current_node); // UNLOCK current node
+        // the batch after a wait is released at start + all waits so far,
+        // so parsing and enqueuing costs never accumulate into drift
+        release += (uint64_t) (record.value > 0 ? record.value : 0) * 1000000000u;
+        source->trace_release += record.value > 0 ? record.value : 0;
+        if (checkpointing) {
+            // everything before the wait can be checkpointed while we sleep
+            countRecord(false);
+            checkpointSeal(&checkpoints);
+            epoch_records = 0;
+        }
 
-                printf("New job available!\n");
-                pthread_cond_signal(&cond_current_note);
+        // pre-stage that batch while its release time has not come yet
+        staged = 0;
+        while (staged < STAGE_CAPACITY && (status = taskReaderNext(&source->input, &record)) > 0) {
+            if (record.op == TASK_WAIT) {
+                lookahead = true;
+                break;
             }
+            source->stage[staged++] = record.value;
+        }
+        // a batch larger than the stage streams in after the release
+
+        logEvent(LOG_VERBOSE, "Sleeping until the next release, %ld tasks staged", staged, 0);
+        uint64_t sleep_start = statsNowNs();
+        uint64_t jitter = sleepUntil(release);
+        t_info->stats.releases++;
+        t_info->stats.release_jitter_sum_ns += jitter;
+        if (jitter > t_info->stats.release_jitter_max_ns) {
+            t_info->stats.release_jitter_max_ns = jitter;
+        }
+        if (stats_enabled) {
+            t_info->stats.idle_ns += statsNowNs() - sleep_start;
+        }
+        logEvent(LOG_VERBOSE, "Waked up %ld us late", jitter / 1000, 0);
+
+        for (size_t i = 0; i < staged; i++) {
+            publish(t_info, source->stage[i]);
+        }
+        if (status <= 0) {
+            break;
+        }
+    }
+    if (status < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (atomic_fetch_sub(&producers_left, 1) == 1) {
+        schedulerClose(&task_scheduler);
+        if (checkpointing) {
+            checkpointFinish(&checkpoints);
+        }
+        parkingWakeAll(&parking);
+        if (async_mode) {
+            asyncDoorbellRingAll(&doorbell);
         }
     }
-    pthread_mutex_lock(&lock_finished);
-    finished_inserting_on_linked_list = true;
-    pthread_mutex_unlock(&lock_finished);
 
-    /* Print instruction linked list */
-    // int k = 1;
-    // node *current_node = instruction_linked_list->next;
-    // do {
-    //     printf("Nó %d: %d\n", k, current_node->value);
-    //     current_node = current_node->next;
-    //     k++;
-    // } while(current_node->next != NULL);
-    // printf("Nó %d: %d\n", k, current_node->value);
+    if (stats_enabled) {
+        uint64_t total = statsNowNs() - start;
+        t_info->stats.busy_ns = total - t_info->stats.idle_ns - t_info->stats.backoff_ns;
+        t_info->stats.contention = mpmc_contention;
+    }
     return NULL;
 }
 
+/*
+ * append a scaling decision to the log; decisions past its capacity are dropped
+ */
+static void logScale(const char *action, int thread_num, int workers) {
+    size_t index = atomic_fetch_add_explicit(&scale_events, 1, memory_order_relaxed);
+    if (index >= SCALE_LOG_CAPACITY) {
+        return;
+    }
+    scale_log[index] = (scale_event) {
+        .at_ns = statsNowNs() - run_start,
+        .action = action,
+        .thread_num = thread_num,
+        .workers = workers,
+        .backlog = schedulerBacklog(&task_scheduler),
+        .latency_ns = atomic_load_explicit(&recent_latency_ns, memory_order_relaxed),
+    };
+}
+
+/*
+ * give up the worker's place in the pool, unless that would leave fewer than elastic_min
+ */
+static bool retire(thread_info *t_info) {
+    int active = atomic_load(&active_workers);
+    while (active > elastic_min) {
+        if (atomic_compare_exchange_weak(&active_workers, &active, active - 1)) {
+            logScale("retire", t_info->thread_num, active - 1);
+            logEvent(LOG_INFO, "Worker %ld retired, %ld active", t_info->thread_num, active - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * whether a parking worker should look at the queues again
+ */
+static bool taskReady(void *arg) {
+    scheduler *sched = arg;
+    return schedulerBacklog(sched) > 0 || schedulerIsClosed(sched);
+}
+
+/*
+ * pop the next task for a worker, spinning then parking while there is none
+ * returns false once the master closed the scheduler and every task was taken,
+ * or when an elastic worker idled long enough to retire
+ */
+static bool nextTask(thread_info *t_info, task *next) {
+    int worker = t_info->thread_num - 2; // workers are numbered from 2
+    unsigned attempt = 0;
+    uint64_t wait_start = 0;
+
+    if (t_info->batch_next == t_info->batch_size) {
+        // claim a new batch
+        t_info->batch_next = 0;
+        while ((t_info->batch_size = schedulerTryPopBatch(&task_scheduler, worker, t_info->batch, SCHEDULE_MAX_CHUNK)) == 0) {
+            if (schedulerIsClosed(&task_scheduler)) {
+                // the master may have pushed right before closing
+                t_info->batch_size = schedulerTryPopBatch(&task_scheduler, worker, t_info->batch, SCHEDULE_MAX_CHUNK);
+                break;
+            }
+            if (attempt++ == 0) {
+                logEvent(LOG_VERBOSE, "No tasks for worker %ld. Waiting...", t_info->thread_num, 0);
+                if (stats_enabled) {
+                    t_info->stats.waits++;
+                }
+                if (stats_enabled || elastic) {
+                    wait_start = statsNowNs();
+                }
+            }
+            uint64_t timeout_ns = 0;
+            if (elastic) {
+                // wake up in time to retire
+                uint64_t idle = statsNowNs() - wait_start;
+                if (idle > ELASTIC_IDLE_NS && retire(t_info)) {
+                    break;
+                }
+                timeout_ns = idle < ELASTIC_IDLE_NS ? ELASTIC_IDLE_NS - idle : ELASTIC_IDLE_NS;
+            }
+            if (parkingWait(&parking, worker, taskReady, &task_scheduler, timeout_ns) && stats_enabled) {
+                t_info->stats.parks++;
+            }
+        }
+        if (stats_enabled && attempt > 0) {
+            t_info->stats.backoff_ns += statsNowNs() - wait_start;
+        }
+        if (t_info->batch_size == 0) {
+            return false;
+        }
+        // we made room: a master parked on full queues can push again
+        parkingWake(&room, 1);
+    }
+    *next = t_info->batch[t_info->batch_next++];
+    return true;
+}
+
 static void * threadStartWorker(void *arg) {
     thread_info *t_info = arg;
-    node* being_worked_node;
+    logAttach(t_info->thread_num);
+    task being_worked_task;
     // printf("Thread trabalhador! num %d\n", t_info->thread_num);
 
-    pthread_mutex_lock(&lock_finished); // LOCK finished
-    pthread_mutex_lock(&lock_current_node);  // LOCK current node
-    while(!finished_inserting_on_linked_list || current_node != NULL) {
-        pthread_mutex_unlock(&lock_finished); // UNLOCK finished
-//        pthread_mutex_unlock(&lock_current_node); // UNLOCK current node
-//
-//        pthread_mutex_lock(&lock_current_node); // LOCK current node
-        while (current_node == NULL) {
-            printf("No tasks for worker %d. Waiting...\n", t_info->thread_num);
-            pthread_cond_wait(&cond_current_note, &lock_current_node); // WAIT current node
+    // allocated here so first touch puts them on this worker's NUMA node;
+    // a respawned elastic worker carries on with what its slot already holds
+    if (!t_info->initialized) {
+        if (accumulatorInit(&t_info->partial, aggregates, num_aggregates) != 0) {
+            handleError("accumulator allocation");
+        }
+        if (kernelContextInit(&t_info->context, &kernel) != 0) {
+            handleError("kernel context allocation");
         }
-        printf("Worker %d executing task: %d seconds to finish!\n", t_info->thread_num, current_node->value);
-        being_worked_node = current_node;
-        current_node = current_node->next;
-        pthread_mutex_unlock(&lock_current_node); // UNLOCK current node
-        update(being_worked_node->value);
+        t_info->initialized = true;
+    }
+
+    uint64_t now = stats_enabled ? statsNowNs() : 0;
+
+    while (nextTask(t_info, &being_worked_task)) {
+        logEvent(LOG_VERBOSE, "Worker %ld executing task: %ld seconds to finish!", t_info->thread_num, being_worked_task.value);
+        if (elastic) {
+            atomic_store_explicit(&recent_latency_ns, statsNowNs() - being_worked_task.enqueued_ns, memory_order_relaxed);
+        }
+        if (!stats_enabled) {
+            update(t_info, &being_worked_task);
+            continue;
+        }
+        uint64_t started = statsNowNs();
+        t_info->stats.idle_ns += started - now;
+        statsRecordLatency(&t_info->stats, started - being_worked_task.enqueued_ns);
+        update(t_info, &being_worked_task);
+        now = statsNowNs();
+        t_info->stats.busy_ns += now - started;
+        t_info->stats.tasks++;
+    }
+    if (stats_enabled) {
+        t_info->stats.idle_ns += statsNowNs() - now;
+        t_info->stats.contention += mpmc_contention;
+    }
+
+    // the controller joins us before reusing the slot
+    atomic_store(&t_info->state, SLOT_RETIRED);
+    return NULL;
+}
+
+/*
+ * --no-simulate: read every process record into values; wait records are dropped
+ */
+static void loadValues(void) {
+    task_record record;
+    size_t capacity = 0;
+    int status;
+
+    for (int i = 0; i < num_inputs; i++) {
+        while ((status = taskReaderNext(&producers[i].input, &record)) > 0) {
+            if (record.op != TASK_PROCESS) {
+                continue;
+            }
+            if (num_values == capacity) {
+                capacity = capacity ? 2 * capacity : 1 << 20;
+                values = realloc(values, capacity * sizeof(long));
+                if (values == NULL) {
+                    handleError("values realloc");
+                }
+            }
+            values[num_values++] = record.value;
+        }
+        if (status < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/*
+ * --no-simulate: reduce the worker's contiguous share of values in one go
+ */
+static void * threadStartReduce(void *arg) {
+    thread_info *t_info = arg;
+    size_t worker = (size_t) t_info->thread_num - 2;
+    size_t num_workers = (size_t) task_scheduler.num_workers;
+    size_t begin = num_values * worker / num_workers;
+    size_t end = num_values * (worker + 1) / num_workers;
+
+    if (accumulatorInit(&t_info->partial, aggregates, num_aggregates) != 0) {
+        handleError("accumulator allocation");
+    }
+    t_info->initialized = true;
+    uint64_t start = statsNowNs();
+    accumulatorAddArray(&t_info->partial, values + begin, end - begin);
+    if (stats_enabled) {
+        t_info->stats.busy_ns = statsNowNs() - start;
+        t_info->stats.tasks = end - begin;
+    }
+    atomic_store(&t_info->state, SLOT_RETIRED);
+    return NULL;
+}
+
+/*
+ * --async: the worker drives all its tasks from one event loop
+ */
+static void * threadStartAsync(void *arg) {
+    thread_info *t_info = arg;
+    logAttach(t_info->thread_num);
+
+    if (accumulatorInit(&t_info->partial, aggregates, num_aggregates) != 0) {
+        handleError("accumulator allocation");
+    }
+    t_info->initialized = true;
+    if (asyncRun(&doorbell, &task_scheduler, t_info->thread_num - 2, t_info->thread_num, &kernel,
+                 &t_info->partial, stats_enabled ? &t_info->stats : NULL) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (stats_enabled) {
+        t_info->stats.contention += mpmc_contention;
+    }
+    atomic_store(&t_info->state, SLOT_RETIRED);
+    return NULL;
+}
+
+/*
+ * make the next thread created with attr run on its CPU of the plan
+ */
+static void pinThread(pthread_attr_t *attr, const affinity_plan *plan, int thread_index) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(affinityCpuFor(plan, thread_index), &cpus);
+    int s = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+    if (s != 0)
+        handleErrorNumber(s, "pthread_attr_setaffinity_np");
+}
+
+/*
+ * start a worker in a slot of threads, pinned like the rest when --pin is given
+ */
+static void startWorker(int slot) {
+    pthread_attr_t attr;
+    int s = pthread_attr_init(&attr);
+    if (s != 0)
+        handleErrorNumber(s, "pthread_attr_init");
+    if (pinned) {
+        pinThread(&attr, &plan, slot);
+    }
+    atomic_store(&threads[slot].state, SLOT_RUNNING);
+    void *(*start)(void *) = &threadStartWorker;
+    if (async_mode) {
+        start = &threadStartAsync;
+    } else if (no_simulate) {
+        start = &threadStartReduce;
+    }
+    s = pthread_create(&threads[slot].thread_id, &attr, start, &threads[slot]);
+    if (s != 0)
+        handleErrorNumber(s, "pthread_create_worker");
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * --checkpoint: write the progress file every time an epoch completes
+ */
+static void * threadStartCheckpoint(void *arg) {
+    (void) arg;
+    if (checkpointRun(&checkpoints) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    return NULL;
+}
 
-        pthread_mutex_lock(&lock_finished); // LOCK finished
-        pthread_mutex_lock(&lock_current_node); // LOCK current node
+/*
+ * --stats: sample the queue occupancy until the workers claimed the last task
+ */
+static void * threadStartSampler(void *arg) {
+    (void) arg;
+
+    for (;;) {
+        // closed is read first: an empty backlog after it stays empty
+        bool closed = schedulerIsClosed(&task_scheduler);
+        size_t backlog = schedulerBacklog(&task_scheduler);
+        occupancyRecord(&occupancy, statsNowNs() - run_start, backlog);
+        if (closed && backlog == 0) {
+            break;
+        }
+        struct timespec pause = {
+            .tv_sec = (time_t) (occupancy.interval_ns / 1000000000u),
+            .tv_nsec = (long) (occupancy.interval_ns % 1000000000u),
+        };
+        nanosleep(&pause, NULL);
     }
-    pthread_mutex_unlock(&lock_finished); // UNLOCK finished
+    return NULL;
+}
 
+/*
+ * elastic mode: add a worker whenever the backlog or the start latency grows too large;
+ * workers retire themselves once idle for ELASTIC_IDLE_NS
+ */
+static void * threadStartController(void *arg) {
+    struct timespec tick = { 0, ELASTIC_TICK_NS };
+    (void) arg;
+    logAttach(0); // thread numbers start at 1, so ring 0 is free
+
+    for (;;) {
+        size_t backlog = schedulerBacklog(&task_scheduler);
+        if (backlog == 0 && schedulerIsClosed(&task_scheduler)) {
+            break; // the running workers finish the claimed tasks
+        }
+        int active = atomic_load(&active_workers);
+        uint64_t latency = atomic_load_explicit(&recent_latency_ns, memory_order_relaxed);
+        bool behind = backlog > (size_t) active * ELASTIC_BACKLOG_PER_WORKER
+                      || (backlog > 0 && latency > ELASTIC_LATENCY_NS);
+        for (int slot = 1; behind && active < elastic_max && slot <= elastic_max; slot++) {
+            int state = atomic_load(&threads[slot].state);
+            if (state == SLOT_RUNNING) {
+                continue;
+            }
+            if (state == SLOT_RETIRED) {
+                int s = pthread_join(threads[slot].thread_id, NULL);
+                if (s != 0)
+                    handleErrorNumber(s, "pthread_join");
+            }
+            atomic_fetch_add(&active_workers, 1);
+            startWorker(slot);
+            logScale("spawn", threads[slot].thread_num, active + 1);
+            logEvent(LOG_INFO, "Worker %ld spawned, %ld active", threads[slot].thread_num, active + 1);
+            break;
+        }
+        nanosleep(&tick, NULL);
+    }
     return NULL;
 }
 
 int main(int argc, char *argv[]) {
-    int opt, num_threads, i = 0;
-    char *file_name = NULL, buffer[4], *token;
-    FILE *file;
+    int opt, num_threads, parse_threads = 1;
+    schedule_mode mode = SCHEDULE_FIFO;
+    size_t chunk = 1;
+    bool guided = false;
+    glob_t file_names;  /* every -f, globs expanded */
+    int num_patterns = 0;
+    const char *kernel_spec = "sleep";
+    const char *pin_spec = NULL;
+    const char *serve_path = NULL, *connect_path = NULL;
+    int *worker_node = NULL;
+    stats_format stats_output = STATS_JSON;
+    static const struct option long_options[] = {
+        { "stats", optional_argument, NULL, 'S' },
+        { "pin", required_argument, NULL, 'I' },
+        { "elastic", required_argument, NULL, 'E' },
+        { "serve", required_argument, NULL, 'R' },
+        { "connect", required_argument, NULL, 'C' },
+        { "async", no_argument, NULL, 'A' },
+        { "no-simulate", no_argument, NULL, 'N' },
+        { "checkpoint", required_argument, NULL, 'K' },
+        { "checkpoint-every", required_argument, NULL, 'B' },
+        { "resume", no_argument, NULL, 'U' },
+        { "agg", required_argument, NULL, 'G' },
+        { "queue-capacity", required_argument, NULL, 'Q' },
+        { NULL, 0, NULL, 0 },
+    };
     thread_info *t_info;
+    pthread_t controller, checkpoint_thread, sampler;
+    const char *checkpoint_path = NULL;
+    bool resume = false;
+    accumulator result;
     pthread_attr_t attr;
     void *res;
 
     pthread_t *t = (pthread_t *)malloc(sizeof(pthread_t));
 
     /* Get opt */
-    while ((opt = getopt(argc, argv, "t:f:h")) != -1) {
+    while ((opt = getopt_long(argc, argv, "t:f:s:c:k:P:Q:vqh", long_options, NULL)) != -1) {
         switch(opt) {
             case 't':
                 num_threads = (int) strtoul(optarg, NULL, 0);
@@ -194,13 +679,137 @@ int main(int argc, char *argv[]) {
                 break;
 
             case 'f':
-                file_name = (char*) malloc(strlen(optarg) * sizeof(char));
-                strcpy(file_name, optarg);
+                // a pattern matching nothing stays as it is and fails to open below
+                if (glob(optarg, GLOB_NOCHECK | (num_patterns++ > 0 ? GLOB_APPEND : 0), NULL, &file_names) != 0) {
+                    fprintf(stderr, "Cannot expand '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 's':
+                if (!scheduleModeParse(optarg, &mode)) {
+                    fprintf(stderr, "Unknown scheduling mode: '%s'. Expected value: fifo, steal or lpt\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'c':
+                if (!scheduleChunkParse(optarg, &chunk, &guided)) {
+                    fprintf(stderr, "Invalid chunk: '%s'. Expected value: 1 to %d, guided or guided:N\n", optarg, SCHEDULE_MAX_CHUNK);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'k':
+                kernel_spec = optarg;
+                break;
+
+            case 'P':
+                parse_threads = (int) strtoul(optarg, NULL, 0);
+                if (parse_threads < 1) {
+                    fprintf(stderr, "Invalid number of parse threads: %d. Expected value: 1 or more\n", parse_threads);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'Q':
+                queue_capacity = strtoul(optarg, NULL, 0);
+                if (queue_capacity < 1) {
+                    fprintf(stderr, "Invalid queue capacity: '%s'. Expected value: 1 or more tasks\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'v':
+                log_threshold = LOG_VERBOSE;
+                break;
+
+            case 'q':
+                log_threshold = LOG_QUIET;
+                break;
+
+            case 'S':
+                stats_enabled = true;
+                if (optarg != NULL && !statsFormatParse(optarg, &stats_output)) {
+                    fprintf(stderr, "Unknown stats format: '%s'. Expected value: json or csv\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'I':
+                pin_spec = optarg;
+                break;
+
+            case 'E':
+                elastic = sscanf(optarg, "%d:%d", &elastic_min, &elastic_max) == 2;
+                if (!elastic || elastic_min < 1 || elastic_max < elastic_min) {
+                    fprintf(stderr, "Invalid elastic pool: '%s'. Expected value: MIN:MAX with 1 <= MIN <= MAX\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'R':
+                serve_path = optarg;
+                break;
+
+            case 'C':
+                connect_path = optarg;
+                break;
+
+            case 'A':
+                async_mode = true;
+                break;
+
+            case 'N':
+                no_simulate = true;
+                break;
+
+            case 'K':
+                checkpoint_path = optarg;
+                checkpointing = true;
+                break;
+
+            case 'B':
+                checkpoint_every = strtoull(optarg, NULL, 0);
+                if (checkpoint_every < 1) {
+                    fprintf(stderr, "Invalid checkpoint interval: '%s'. Expected value: 1 or more records\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'U':
+                resume = true;
+                break;
+
+            case 'G':
+                if (!aggregateListParse(optarg, aggregates, &num_aggregates)) {
+                    fprintf(stderr, "Invalid aggregate list: '%s'. Expected values: basic, welford, histogram, tdigest or hll, comma-separated\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
                 break;
 
             case 'h':
                 printf("=== Master Worker ===\n\nArguments:\n-t Number of workers (ex: -t 8)\n"
-                       "-f File name (ex: -f file.txt)\n-h Help\n");
+                       "-f File name; repeat it or quote a glob to stream several inputs, one master each (ex: -f 'shards/*.txt')\n"
+                       "-s Scheduling mode: fifo (default), steal or lpt (longest task first) (ex: -s lpt)\n"
+                       "-c Tasks claimed per dequeue in fifo and lpt modes: N, guided or guided:N (ex: -c guided:4)\n"
+                       "-P Threads parsing the input up front, each a range of lines (ex: -P 4)\n"
+                       "-Q, --queue-capacity Tasks queued ahead of the workers before the master waits, 1024 by default, at least one per queue (ex: -Q 64)\n"
+                       "-k Task kernel: sleep (default), spin[:US], stream[:KB], none or so:PATH (ex: -k spin:100)\n"
+                       "-v Log every task and wait to stdout (the default logs only workers joining and leaving)\n"
+                       "-q Log nothing\n"
+                       "--stats[=json|csv] Per-thread counters on stderr at exit (ex: --stats=csv)\n"
+                       "--pin Thread placement: compact, scatter or a CPU list (ex: --pin 0,2,4-7)\n"
+                       "--elastic Grow and shrink the workers between MIN and MAX, replaces -t (ex: --elastic 1:8)\n"
+                       "--serve Serve the tasks to worker processes on a Unix socket, replaces -t (ex: --serve /tmp/ms.sock)\n"
+                       "--connect Run as a worker process of a --serve master, -k and -c apply (ex: --connect /tmp/ms.sock)\n"
+                       "--async Workers run sleep tasks as timers in event loops instead of blocking (ex: -t 3 --async)\n"
+                       "--no-simulate Only aggregate: read all values, then reduce them with SIMD, ignoring waits and -k\n"
+                       "--checkpoint Write progress to a file at every wait and every N records (ex: --checkpoint run.ck)\n"
+                       "--checkpoint-every Records per checkpoint, 10000 by default (ex: --checkpoint-every 500)\n"
+                       "--resume Continue from the --checkpoint file, skipping the records it covers\n"
+                       "--agg Reductions, one output line each: basic (default), welford, histogram, tdigest, hll (ex: --agg basic,tdigest)\n"
+                       "-h Help\n");
                 break;
 
             default:
@@ -209,28 +818,135 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    /* Reading file */
-    file = fopen(file_name, "r");
-    if(file == NULL) {
-        fprintf(stderr, "Error opening file '%s'\n", file_name);
+    if (elastic) {
+        if (mode == SCHEDULE_STEAL) {
+            // steal mode deals tasks to every worker's inbox, absent ones included
+            fprintf(stderr, "--elastic does not support the steal scheduling mode\n");
+            exit(EXIT_FAILURE);
+        }
+        num_threads = elastic_max + 1;
+    }
+
+    if (taskKernelOpen(&kernel, kernel_spec) != 0) {
         exit(EXIT_FAILURE);
     }
 
-    /* Count number of lines in the file */
-    for (char c = getc(file); c != EOF; c = getc(file))
-        if (c == '\n') // Increment count if this character is newline
-            file_size = file_size + 1;
-    file_size++;
-    fseek(file, 0, SEEK_SET);
+    /* Worker process: everything comes from the master */
+    if (connect_path != NULL) {
+        if (accumulatorInit(&result, aggregates, num_aggregates) != 0) {
+            handleError("accumulator allocation");
+        }
+        if (logInit(1) != 0) {
+            handleError("log allocation");
+        }
+        logAttach(0);
+        int status = remoteWork(connect_path, &kernel, &result, chunk);
+        logShutdown();
+        accumulatorDestroy(&result);
+        taskKernelClose(&kernel);
+        return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (resume && !checkpointing) {
+        fprintf(stderr, "--resume needs --checkpoint\n");
+        exit(EXIT_FAILURE);
+    }
+    if (checkpointing && (no_simulate || async_mode || serve_path != NULL)) {
+        fprintf(stderr, "--checkpoint does not apply to --no-simulate, --async or --serve\n");
+        exit(EXIT_FAILURE);
+    }
+    if (no_simulate && (async_mode || elastic || serve_path != NULL)) {
+        fprintf(stderr, "--no-simulate does not apply to --async, --elastic or --serve\n");
+        exit(EXIT_FAILURE);
+    }
+    if (async_mode) {
+        if (!asyncKernelSupported(&kernel)) {
+            fprintf(stderr, "--async needs the sleep or none kernel\n");
+            exit(EXIT_FAILURE);
+        }
+        if (elastic || serve_path != NULL) {
+            fprintf(stderr, "--async does not apply to --elastic or --serve\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (serve_path != NULL) {
+        if (elastic) {
+            fprintf(stderr, "--elastic does not apply to --serve\n");
+            exit(EXIT_FAILURE);
+        }
+        num_threads = 1; // only the master; the workers are other processes
+    }
 
-    /* Allocating the list with all tasks */
-    task_list = malloc(file_size * sizeof(instruction));
-    while(fgets(buffer , 8192, file) != NULL) {
-        token = strtok(buffer, " ");
-        strcpy(task_list[i].instruction_type, token);
-        token = strtok(NULL, "\n");
-        task_list[i].value = (int) strtoul(token, NULL, 0);
-        i++;
+    /* Opening files; every master streams its own while the workers run */
+    if (num_patterns == 0) {
+        fprintf(stderr, "Error opening file ''\n");
+        exit(EXIT_FAILURE);
+    }
+    num_inputs = (int) file_names.gl_pathc;
+    producers = calloc(num_inputs, sizeof(producer));
+    if (producers == NULL) {
+        handleError("producers calloc");
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        if (taskReaderOpen(&producers[i].input, file_names.gl_pathv[i]) != 0) {
+            fprintf(stderr, "Error opening file '%s'\n", file_names.gl_pathv[i]);
+            exit(EXIT_FAILURE);
+        }
+        if (parse_threads > 1 && taskReaderParseParallel(&producers[i].input, parse_threads) != 0) {
+            handleError("parallel parse");
+        }
+    }
+    atomic_init(&producers_left, num_inputs);
+    if (checkpointing && num_inputs > 1) {
+        fprintf(stderr, "--checkpoint takes a single input file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // with --serve the master's own server loop pops as the only local worker
+    int num_workers = num_threads > 1 ? num_threads - 1 : 1;
+    // the first master is slot 0, the other ones come after the workers
+    int num_slots = num_threads + num_inputs - 1;
+
+    /* Placement: thread i runs on the i-th CPU of the plan, queues follow their workers' nodes */
+    if (pin_spec != NULL) {
+        if (affinityPlanInit(&plan, pin_spec) != 0) {
+            exit(EXIT_FAILURE);
+        }
+        pinned = true;
+        worker_node = malloc(num_workers * sizeof(int));
+        if (worker_node == NULL) {
+            handleError("worker_node malloc");
+        }
+        for (int worker = 0; worker < num_workers; worker++) {
+            worker_node[worker] = affinityNodeOfCpu(affinityCpuFor(&plan, worker + 1));
+        }
+    }
+
+    if (schedulerInit(&task_scheduler, mode, num_workers, queue_capacity, worker_node) != 0) {
+        handleError("scheduler allocation");
+    }
+    task_scheduler.chunk = chunk;
+    task_scheduler.guided = guided;
+    if (parkingInit(&parking, num_workers) != 0 || parkingInit(&room, num_inputs) != 0) {
+        handleError("parking allocation");
+    }
+    if (mode == SCHEDULE_LPT && num_inputs == 1
+        && (makespanInit(&fifo_makespan, num_workers, false) != 0
+            || makespanInit(&lpt_makespan, num_workers, true) != 0)) {
+        handleError("makespan allocation");
+    }
+    if (async_mode && asyncDoorbellInit(&doorbell, num_workers) != 0) {
+        handleError("doorbell allocation");
+    }
+    if (checkpointing) {
+        if (checkpointInit(&checkpoints, checkpoint_path, producers[0].input.size, num_workers, aggregates, num_aggregates) != 0) {
+            handleError("checkpoint allocation");
+        }
+        if (resume && (resume_records = checkpointLoad(&checkpoints)) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        int s = pthread_create(&checkpoint_thread, NULL, &threadStartCheckpoint, NULL);
+        if (s != 0)
+            handleErrorNumber(s, "pthread_create_checkpoint");
     }
 
     /* Creating threads */
@@ -239,40 +955,167 @@ int main(int argc, char *argv[]) {
         handleErrorNumber(s, "pthread_attr_init");
     }
 
-    t_info = calloc(num_threads, sizeof(thread_info));
+    // aligned so per-thread counters never share a cache line
+    t_info = aligned_alloc(CACHE_LINE_SIZE, num_slots * sizeof(thread_info));
     if(t_info == NULL) {
         handleError("t_info calloc");
     }
+    memset(t_info, 0, num_slots * sizeof(thread_info));
+    threads = t_info;
+    if (accumulatorInit(&result, aggregates, num_aggregates) != 0) {
+        handleError("accumulator allocation");
+    }
+    run_start = statsNowNs();
+    // rings for the elastic controller (0) and every thread by number
+    if (logInit(num_slots + 1) != 0) {
+        handleError("log allocation");
+    }
 
-    t_info[0].thread_num = 1;
-    s = pthread_create(&t_info[0].thread_id, &attr, &threadStartMaster, &t_info[0]);
-    if(s != 0)
-        handleErrorNumber(s, "pthread_create_master");
+    // --no-simulate has no queue to watch
+    bool sampling = stats_enabled && !no_simulate;
+    if (sampling) {
+        occupancyInit(&occupancy, schedulerCapacity(&task_scheduler), OCCUPANCY_INTERVAL_NS);
+        s = pthread_create(&sampler, NULL, &threadStartSampler, NULL);
+        if (s != 0)
+            handleErrorNumber(s, "pthread_create_sampler");
+    }
+
+    for (int i = 0; i < num_inputs; i++) {
+        int slot = i == 0 ? 0 : num_threads + i - 1;
+        t_info[slot].thread_num = slot + 1;
+        t_info[slot].source = &producers[i];
+        statsInit(&t_info[slot].stats, "master", slot + 1);
+    }
+    if (no_simulate) {
+        // the master's whole job is reading the inputs before the workers start
+        uint64_t load_start = statsNowNs();
+        loadValues();
+        t_info[0].stats.busy_ns = statsNowNs() - load_start;
+        t_info[0].stats.tasks = num_values;
+    } else {
+        for (int i = 0; i < num_inputs; i++) {
+            int slot = i == 0 ? 0 : num_threads + i - 1;
+            if (pin_spec != NULL) {
+                pinThread(&attr, &plan, slot);
+            }
+            atomic_store(&t_info[slot].state, SLOT_RUNNING);
+            s = pthread_create(&t_info[slot].thread_id, &attr, &threadStartMaster, &t_info[slot]);
+            if(s != 0)
+                handleErrorNumber(s, "pthread_create_master");
+        }
+    }
 
     for (int thread_num = 1; thread_num < num_threads; thread_num++) {
         t_info[thread_num].thread_num = thread_num + 1;
-        s = pthread_create(&t_info[thread_num].thread_id, &attr, &threadStartWorker, &t_info[thread_num]);
-        if(s != 0)
-            handleErrorNumber(s, "pthread_create_worker");
+        statsInit(&t_info[thread_num].stats, "worker", thread_num + 1);
+        if (!elastic || thread_num <= elastic_min) {
+            startWorker(thread_num);
+        }
     }
 
     s = pthread_attr_destroy(&attr);
     if(s != 0)
         handleErrorNumber(s, "pthread_attr_destroy");
 
-    for (int thread_num = 0; thread_num < num_threads; thread_num++) {
+    if (serve_path != NULL && remoteServe(serve_path, &task_scheduler, &result) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (elastic) {
+        atomic_store(&active_workers, elastic_min);
+        s = pthread_create(&controller, NULL, &threadStartController, NULL);
+        if (s != 0)
+            handleErrorNumber(s, "pthread_create_controller");
+        s = pthread_join(controller, NULL);
+        if (s != 0)
+            handleErrorNumber(s, "pthread_join");
+    }
+
+    for (int thread_num = 0; thread_num < num_slots; thread_num++) {
+        if (atomic_load(&t_info[thread_num].state) == SLOT_IDLE) {
+            continue; // an elastic slot that was never needed, or --no-simulate masters
+        }
         s = pthread_join(t_info[thread_num].thread_id, &res);
         if(s != 0)
             handleErrorNumber(s, "pthread_join");
         // printf("Joined with thread %d; returned value was %s\n", t_info[thread_num].thread_num, (char *) res);
         free(res);      /* Free memory allocated by thread */
     }
+    if (sampling) {
+        s = pthread_join(sampler, NULL);
+        if (s != 0)
+            handleErrorNumber(s, "pthread_join");
+    }
+    if (checkpointing) {
+        s = pthread_join(checkpoint_thread, NULL);
+        if (s != 0)
+            handleErrorNumber(s, "pthread_join");
+    }
+    uint64_t run_ns = statsNowNs() - run_start;
+    logShutdown(); // every logging thread is gone, flush before the results
+    if (pin_spec != NULL) {
+        affinityPlanDestroy(&plan);
+        free(worker_node);
+    }
+
+    if (stats_enabled) {
+        thread_stats *all = aligned_alloc(CACHE_LINE_SIZE, num_slots * sizeof(thread_stats));
+        if (all == NULL) {
+            handleError("stats allocation");
+        }
+        for (int thread_num = 0; thread_num < num_slots; thread_num++) {
+            all[thread_num] = t_info[thread_num].stats;
+        }
+        size_t num_events = atomic_load(&scale_events);
+        statsPrint(stderr, stats_output, all, num_slots, scale_log,
+                   num_events < SCALE_LOG_CAPACITY ? num_events : SCALE_LOG_CAPACITY,
+                   sampling ? &occupancy : NULL);
+        free(all);
+    }
+
+    /* Folding the private aggregates of every worker */
+    for (int thread_num = 1; thread_num < num_threads; thread_num++) {
+        if (!t_info[thread_num].initialized) {
+            continue;
+        }
+        accumulatorMerge(&result, &t_info[thread_num].partial);
+        accumulatorDestroy(&t_info[thread_num].partial);
+        kernelContextDestroy(&t_info[thread_num].context);
+    }
+    if (checkpointing) {
+        accumulatorMerge(&result, &checkpoints.total);
+        checkpointDestroy(&checkpoints);
+    }
+    taskKernelClose(&kernel);
 
-    fclose(file);
-    free(task_list);
+    for (int i = 0; i < num_inputs; i++) {
+        taskReaderClose(&producers[i].input);
+    }
+    free(producers);
+    globfree(&file_names);
+    schedulerDestroy(&task_scheduler);
+    parkingDestroy(&parking);
+    parkingDestroy(&room);
+    if (async_mode) {
+        asyncDoorbellDestroy(&doorbell);
+    }
+
+    /* lpt: what the same input would have taken in arrival order */
+    if (mode == SCHEDULE_LPT && num_threads > 1 && num_inputs == 1) {
+        long fifo = makespanFinish(&fifo_makespan);
+        long lpt = makespanFinish(&lpt_makespan);
+        fprintf(stderr, "Estimated makespan on %d workers: fifo %ld, lpt %ld%s (%.1f%% shorter), measured %.3f s\n",
+                num_threads - 1, fifo, lpt, lpt_makespan.overflowed ? " (window overflowed)" : "",
+                fifo > 0 ? 100.0 * (fifo - lpt) / fifo : 0.0, run_ns / 1e9);
+    }
+    if (mode == SCHEDULE_LPT && num_inputs == 1) {
+        makespanDestroy(&fifo_makespan);
+        makespanDestroy(&lpt_makespan);
+    }
+    free(values);
 
     // print results
-    printf("%ld %ld %ld %ld\n", sum, odd, min, max);
+    accumulatorPrint(&result, stdout);
+    accumulatorDestroy(&result);
 
     // clean up and return
     return (EXIT_SUCCESS);
@@ -0,0 +1,116 @@
+/*
+ * parking.c
+ */
+
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking.h"
+
+enum {
+    PARKER_RUNNING,
+    PARKER_PARKED,
+    PARKER_NOTIFIED,
+};
+
+static inline void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void futexWait(atomic_uint *word, unsigned expected, uint64_t timeout_ns)
+{
+    struct timespec timeout = {
+        .tv_sec = (time_t) (timeout_ns / 1000000000u),
+        .tv_nsec = (long) (timeout_ns % 1000000000u),
+    };
+    // returns at once if the word changed already; EINTR and spurious wake-ups are fine
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, timeout_ns ? &timeout : NULL, NULL, 0);
+}
+
+static void futexWake(atomic_uint *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+int parkingInit(parking_lot *lot, int count)
+{
+    lot->parkers = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(parker));
+    if (lot->parkers == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        atomic_init(&lot->parkers[i].state, PARKER_RUNNING);
+    }
+    lot->count = count;
+    atomic_init(&lot->num_parked, 0);
+    atomic_init(&lot->next_wake, 0);
+    return 0;
+}
+
+void parkingDestroy(parking_lot *lot)
+{
+    free(lot->parkers);
+    lot->parkers = NULL;
+}
+
+bool parkingWait(parking_lot *lot, int worker, bool (*ready)(void *), void *arg, uint64_t timeout_ns)
+{
+    parker *self = &lot->parkers[worker];
+
+    for (int i = 0; i < PARK_SPINS; i++) {
+        if (ready(arg)) {
+            return false;
+        }
+        cpuRelax();
+    }
+
+    atomic_store(&self->state, PARKER_PARKED);
+    atomic_fetch_add(&lot->num_parked, 1);
+    // pairs with the fence in parkingWake: either the waker sees us parked,
+    // or we see the task it published before looking
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!ready(arg)) {
+        futexWait(&self->state, PARKER_PARKED, timeout_ns);
+    }
+    if (atomic_exchange(&self->state, PARKER_RUNNING) == PARKER_PARKED) {
+        // nobody woke us, so nobody took us off the count
+        atomic_fetch_sub(&lot->num_parked, 1);
+    }
+    return true;
+}
+
+int parkingWake(parking_lot *lot, int n)
+{
+    int woken = 0;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&lot->num_parked, memory_order_relaxed) == 0) {
+        return 0; // the common case while the workers are busy
+    }
+    int start = atomic_load_explicit(&lot->next_wake, memory_order_relaxed);
+    for (int i = 0; i < lot->count && woken < n; i++) {
+        parker *p = &lot->parkers[(start + i) % lot->count];
+        unsigned expected = PARKER_PARKED;
+        if (atomic_compare_exchange_strong(&p->state, &expected, PARKER_NOTIFIED)) {
+            atomic_fetch_sub(&lot->num_parked, 1);
+            futexWake(&p->state);
+            woken++;
+        }
+    }
+    // spread the wake-ups so the same worker is not always the first one
+    atomic_store_explicit(&lot->next_wake, (start + 1) % lot->count, memory_order_relaxed);
+    return woken;
+}
+
+void parkingWakeAll(parking_lot *lot)
+{
+    parkingWake(lot, lot->count);
+}
@@ -0,0 +1,52 @@
+/*
+ * parking.h
+ *
+ * Where idle workers wait for tasks. A worker first spins for a short while
+ * checking whether work showed up, then parks on a futex word of its own.
+ * The master wakes one parked worker per task it publishes, and only pays
+ * for a system call when somebody is actually parked.
+ */
+
+#ifndef PARKING_H
+#define PARKING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache_line.h"
+
+/* pause instructions spent polling before a worker parks */
+#define PARK_SPINS 2000
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint state; /* running, parked or notified; the futex word */
+} parker;
+
+typedef struct {
+    parker *parkers;
+    int count;
+    _Alignas(CACHE_LINE_SIZE) atomic_int num_parked;
+    atomic_int next_wake; /* where the next scan for parked workers starts; wakers may race on it */
+} parking_lot;
+
+/* returns 0 on success, -1 on allocation failure */
+int parkingInit(parking_lot *lot, int count);
+void parkingDestroy(parking_lot *lot);
+
+/*
+ * worker only: spin while ready(arg) is false, then park until woken, ready(arg)
+ * turned true before parking, or timeout_ns passed (0 waits without a limit)
+ * returns true if the worker actually parked
+ */
+bool parkingWait(parking_lot *lot, int worker, bool (*ready)(void *), void *arg, uint64_t timeout_ns);
+
+/*
+ * wake up to n parked workers, called after publishing n tasks; any thread
+ * returns how many were woken
+ */
+int parkingWake(parking_lot *lot, int n);
+/* wake everyone, e.g. once no more tasks will come */
+void parkingWakeAll(parking_lot *lot);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+ * remote.c
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "remote.h"
+#include "task_format.h"
+#include "wire.h"
+
+/* how long a worker keeps trying to reach a master that is not listening yet */
+#define CONNECT_RETRY_NS 5000000000LL
+#define CONNECT_PAUSE_NS 10000000L
+
+typedef struct {
+    int fd;
+    bool greeted;                   /* its reductions match the master's */
+    bool waiting;                   /* a request has not been answered yet */
+    uint32_t want;
+    task batch[SCHEDULE_MAX_CHUNK]; /* handed out, partial not received yet */
+    size_t batch_size;
+} remote_worker;
+
+typedef struct {
+    remote_worker workers[REMOTE_MAX_WORKERS];
+    int num_workers;
+    task *orphans;                  /* batches of workers that went away */
+    size_t num_orphans, orphans_capacity;
+} remote_server;
+
+static unsigned char payload[WIRE_MAX_PAYLOAD];
+
+static int unixAddress(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Socket path too long: '%s'\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/*
+ * the reductions of acc as "basic,hll", the way --agg names them
+ */
+static void aggregateNames(const accumulator *acc, char *out, size_t capacity)
+{
+    size_t used = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < acc->count && used < capacity; i++) {
+        used += (size_t) snprintf(out + used, capacity - used, "%s%s", i ? "," : "", acc->ops[i]->name);
+    }
+}
+
+/*
+ * tell a worker why it is being turned away, before its connection is closed
+ */
+static void refuse(int fd, const char *reason)
+{
+    fprintf(stderr, "Refusing a worker: %s\n", reason);
+    if (wireSend(fd, WIRE_REFUSED, reason, (uint32_t) strlen(reason)) != 0) {
+        perror("wireSend");
+    }
+}
+
+/*
+ * forget a worker, keeping its unfinished batch for someone else
+ */
+static void dropWorker(remote_server *server, int index)
+{
+    remote_worker *w = &server->workers[index];
+    if (server->num_orphans + w->batch_size > server->orphans_capacity) {
+        size_t capacity = server->orphans_capacity ? 2 * server->orphans_capacity : 4 * SCHEDULE_MAX_CHUNK;
+        while (capacity < server->num_orphans + w->batch_size) {
+            capacity *= 2;
+        }
+        task *orphans = realloc(server->orphans, capacity * sizeof(task));
+        if (orphans == NULL) {
+            perror("orphans realloc");
+            exit(EXIT_FAILURE);
+        }
+        server->orphans = orphans;
+        server->orphans_capacity = capacity;
+    }
+    if (w->batch_size > 0) {
+        fprintf(stderr, "Worker connection lost, requeuing %zu tasks\n", w->batch_size);
+    }
+    memcpy(server->orphans + server->num_orphans, w->batch, w->batch_size * sizeof(task));
+    server->num_orphans += w->batch_size;
+    close(w->fd);
+    server->workers[index] = server->workers[--server->num_workers];
+}
+
+/*
+ * fill a worker's batch, orphans first; returns how many tasks it got
+ */
+static size_t takeTasks(remote_server *server, scheduler *sched, remote_worker *w)
+{
+    size_t count = 0;
+    while (count < w->want && server->num_orphans > 0) {
+        w->batch[count++] = server->orphans[--server->num_orphans];
+    }
+    if (count == 0) {
+        // the worker sized its batch with its own -c, not the master's
+        count = schedulerTryPopUpTo(sched, 0, w->batch, w->want);
+    }
+    return w->batch_size = count;
+}
+
+/*
+ * read the hello or one request; returns false when the worker has to be dropped
+ */
+static bool readRequest(remote_worker *w, accumulator *result, accumulator *partial, size_t state_size,
+                        const char *names)
+{
+    char reason[2 * REMOTE_NAMES_MAX + 64];
+    uint8_t type;
+    uint32_t length;
+    // one byte short, so a hello can be terminated in place
+    int status = wireRecv(w->fd, &type, payload, sizeof(payload) - 1, &length);
+    if (status < 0) {
+        perror("wireRecv");
+    }
+    if (status <= 0) {
+        return false;
+    }
+    if (type == WIRE_HELLO && !w->greeted) {
+        payload[length] = '\0';
+        if (strcmp((const char *) payload, names) != 0) {
+            snprintf(reason, sizeof(reason), "worker --agg %.*s does not match master --agg %s",
+                     REMOTE_NAMES_MAX, (const char *) payload, names);
+            refuse(w->fd, reason);
+            return false;
+        }
+        w->greeted = true;
+        if (wireSend(w->fd, WIRE_HELLO, NULL, 0) != 0) {
+            perror("wireSend");
+            return false;
+        }
+        return true;
+    }
+    if (!w->greeted) {
+        refuse(w->fd, "no hello before its first request");
+        return false;
+    }
+    if (type != WIRE_REQUEST || w->waiting || (length != 4 && length != 4 + state_size)) {
+        refuse(w->fd, "malformed request");
+        return false;
+    }
+    if (length > 4) {
+        // the previous batch is done: its tasks count once, here
+        if (!accumulatorLoad(partial, payload + 4)) {
+            refuse(w->fd, "invalid aggregate states");
+            return false;
+        }
+        accumulatorMerge(result, partial);
+    }
+    w->batch_size = 0;
+    w->want = loadLe32(payload);
+    if (w->want < 1) {
+        w->want = 1;
+    } else if (w->want > SCHEDULE_MAX_CHUNK) {
+        w->want = SCHEDULE_MAX_CHUNK;
+    }
+    w->waiting = true;
+    return true;
+}
+
+int remoteServe(const char *path, scheduler *sched, accumulator *result)
+{
+    static remote_server server;
+    struct pollfd fds[REMOTE_MAX_WORKERS + 1];
+    struct sockaddr_un addr;
+    accumulator partial;
+    size_t state_size = accumulatorStateSize(result);
+    char names[REMOTE_NAMES_MAX];
+    bool drained = false;
+
+    if (unixAddress(path, &addr) != 0) {
+        return -1;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path); // a socket file left by an earlier run
+    if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(listener, REMOTE_MAX_WORKERS) != 0) {
+        perror(path);
+        close(listener);
+        return -1;
+    }
+    if (accumulatorInit(&partial, result->ops, result->count) != 0) {
+        perror("accumulator allocation");
+        exit(EXIT_FAILURE);
+    }
+    aggregateNames(result, names, sizeof(names));
+
+    for (;;) {
+        // answer pending requests while there is anything to hand out
+        bool pending = false, busy = false;
+        for (int i = 0; i < server.num_workers; i++) {
+            remote_worker *w = &server.workers[i];
+            if (!w->waiting) {
+                busy |= w->batch_size > 0;
+                continue;
+            }
+            // closed is read first: an empty pop after it means the master pushed everything
+            bool closed = schedulerIsClosed(sched);
+            size_t count = takeTasks(&server, sched, w);
+            if (count == 0) {
+                drained = closed;
+                pending = !drained;
+                continue;
+            }
+            for (size_t j = 0; j < count; j++) {
+                storeLe64(payload + 8 * j, (uint64_t) w->batch[j].value);
+            }
+            w->waiting = false;
+            busy = true;
+            if (wireSend(w->fd, WIRE_TASKS, payload, (uint32_t) (8 * count)) != 0) {
+                perror("wireSend");
+                dropWorker(&server, i--);
+            }
+        }
+        if (drained && !busy && server.num_orphans == 0) {
+            break; // every batch came back
+        }
+
+        fds[0] = (struct pollfd) { .fd = listener, .events = POLLIN };
+        for (int i = 0; i < server.num_workers; i++) {
+            fds[i + 1] = (struct pollfd) { .fd = server.workers[i].fd, .events = POLLIN };
+        }
+        // waiting requests look at the scheduler again every millisecond
+        int ready = poll(fds, server.num_workers + 1, pending ? 1 : 100);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        // back to front, as dropping a worker moves the last one into its place
+        int polled = server.num_workers;
+        for (int i = polled - 1; i >= 0; i--) {
+            if (fds[i + 1].revents != 0 && !readRequest(&server.workers[i], result, &partial, state_size, names)) {
+                dropWorker(&server, i);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd < 0) {
+                perror("accept");
+            } else if (server.num_workers == REMOTE_MAX_WORKERS) {
+                refuse(fd, "the master already serves as many workers as it can");
+                close(fd);
+            } else {
+                server.workers[server.num_workers++] = (remote_worker) { .fd = fd };
+            }
+        }
+    }
+
+    // idle workers and the ones still asking are told to stop
+    while (server.num_workers > 0) {
+        remote_worker *w = &server.workers[--server.num_workers];
+        wireSend(w->fd, WIRE_DONE, NULL, 0);
+        close(w->fd);
+    }
+    close(listener);
+    unlink(path);
+    accumulatorDestroy(&partial);
+    free(server.orphans);
+    return 0;
+}
+
+static int connectMaster(const char *path)
+{
+    struct sockaddr_un addr;
+    struct timespec pause = { 0, CONNECT_PAUSE_NS };
+    long long waited = 0;
+
+    if (unixAddress(path, &addr) != 0) {
+        return -1;
+    }
+    for (;;) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            perror("socket");
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        int error = errno;
+        close(fd);
+        // the master may not be listening yet
+        if ((error != ENOENT && error != ECONNREFUSED) || waited >= CONNECT_RETRY_NS) {
+            errno = error;
+            perror(path);
+            return -1;
+        }
+        nanosleep(&pause, NULL);
+        waited += CONNECT_PAUSE_NS;
+    }
+}
+
+/*
+ * send our reductions and wait for the master to accept them
+ * returns 0 when accepted, -1 after printing the reason
+ */
+static int greet(int fd, const char *names)
+{
+    uint8_t type;
+    uint32_t length;
+    if (wireSend(fd, WIRE_HELLO, names, (uint32_t) strlen(names)) != 0) {
+        perror("wireSend");
+        return -1;
+    }
+    int received = wireRecv(fd, &type, payload, sizeof(payload), &length);
+    if (received <= 0) {
+        if (received == 0) {
+            fprintf(stderr, "Master closed the connection\n");
+        } else {
+            perror("wireRecv");
+        }
+        return -1;
+    }
+    if (type == WIRE_REFUSED) {
+        fprintf(stderr, "Master refused the connection: %.*s\n", (int) length, (const char *) payload);
+        return -1;
+    }
+    if (type != WIRE_HELLO) {
+        fprintf(stderr, "Unexpected frame from the master\n");
+        return -1;
+    }
+    return 0;
+}
+
+int remoteWork(const char *path, const task_kernel *kernel, accumulator *partial, size_t chunk)
+{
+    kernel_context context;
+    size_t state_size = accumulatorStateSize(partial);
+    char names[REMOTE_NAMES_MAX];
+    bool has_batch = false;
+    int status = -1;
+
+    if (4 + state_size > sizeof(payload)) {
+        fprintf(stderr, "Aggregate states too large for a request\n");
+        return -1;
+    }
+    int fd = connectMaster(path);
+    if (fd < 0) {
+        return -1;
+    }
+    if (kernelContextInit(&context, kernel) != 0) {
+        perror("kernel context allocation");
+        exit(EXIT_FAILURE);
+    }
+    // the master checks these before serving anything
+    aggregateNames(partial, names, sizeof(names));
+    if (greet(fd, names) != 0) {
+        goto out;
+    }
+
+    for (;;) {
+        uint32_t length = 4;
+        uint8_t type;
+        storeLe32(payload, (uint32_t) chunk);
+        if (has_batch) {
+            accumulatorSave(partial, payload + 4);
+            accumulatorReset(partial);
+            length += (uint32_t) state_size;
+        }
+        if (wireSend(fd, WIRE_REQUEST, payload, length) != 0) {
+            perror("wireSend");
+            break;
+        }
+
+        int received = wireRecv(fd, &type, payload, sizeof(payload), &length);
+        if (received <= 0) {
+            if (received == 0) {
+                fprintf(stderr, "Master closed the connection\n");
+            } else {
+                perror("wireRecv");
+            }
+            break;
+        }
+        if (type == WIRE_DONE) {
+            status = 0;
+            break;
+        }
+        if (type == WIRE_REFUSED) {
+            fprintf(stderr, "Master refused the connection: %.*s\n", (int) length, (const char *) payload);
+            break;
+        }
+        if (type != WIRE_TASKS || length % 8 != 0) {
+            fprintf(stderr, "Unexpected frame from the master\n");
+            break;
+        }
+        logEvent(LOG_VERBOSE, "Worker %ld received %ld tasks", getpid(), length / 8);
+        for (uint32_t i = 0; i < length / 8; i++) {
+            long value = (long) loadLe64(payload + 8 * i);
+            logEvent(LOG_VERBOSE, "Worker %ld executing task: %ld seconds to finish!", getpid(), value);
+            taskKernelRun(kernel, &context, value);
+            accumulatorAdd(partial, value);
+        }
+        has_batch = true;
+    }
+
+out:
+    kernelContextDestroy(&context);
+    close(fd);
+    return status;
+}
@@ -0,0 +1,38 @@
+/*
+ * remote.h
+ *
+ * Master/worker over a Unix domain stream socket (see wire.h): the master
+ * process serves the tasks of its scheduler to worker processes started
+ * separately, each asking for batches and returning the partial aggregates
+ * of every finished batch with its next request.
+ */
+
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stddef.h>
+
+#include "aggregate.h"
+#include "scheduler.h"
+#include "task_kernel.h"
+
+/* most worker processes a master serves at once; later ones are turned away */
+#define REMOTE_MAX_WORKERS 64
+/* room for the reduction names both sides compare, as "basic,hll" */
+#define REMOTE_NAMES_MAX 256
+
+/*
+ * listen on path and serve the tasks of sched (popped as worker 0) until it is
+ * closed and every task came back, merging the workers' partials into result
+ * returns 0 on success, -1 after printing the reason to stderr
+ */
+int remoteServe(const char *path, scheduler *sched, accumulator *result);
+
+/*
+ * connect to the master at path and run batches of up to chunk tasks with kernel,
+ * aggregating into partial (set up with the master's reductions)
+ * returns 0 once the master said there is nothing left, -1 after printing the reason
+ */
+int remoteWork(const char *path, const task_kernel *kernel, accumulator *partial, size_t chunk);
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ * scheduler.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "affinity.h"
+#include "scheduler.h"
+
+#define DEQUE_INITIAL_CAPACITY 256
+/* most NUMA nodes the fifo mode keeps separate rings for */
+#define CPU_NODES_MAX 64
+
+bool scheduleModeParse(const char *name, schedule_mode *mode)
+{
+    if (strcmp(name, "fifo") == 0) {
+        *mode = SCHEDULE_FIFO;
+    } else if (strcmp(name, "steal") == 0) {
+        *mode = SCHEDULE_STEAL;
+    } else if (strcmp(name, "lpt") == 0) {
+        *mode = SCHEDULE_LPT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool scheduleChunkParse(const char *text, size_t *chunk, bool *guided)
+{
+    char *end;
+    unsigned long n = 1;
+
+    *guided = strncmp(text, "guided", 6) == 0;
+    if (*guided) {
+        text += 6;
+        if (*text == '\0') {
+            *chunk = 1;
+            return true;
+        }
+        if (*text++ != ':') {
+            return false;
+        }
+    }
+    n = strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || n < 1 || n > SCHEDULE_MAX_CHUNK) {
+        return false;
+    }
+    *chunk = n;
+    return true;
+}
+
+/*
+ * share of capacity for the i-th of count queues, so that the shares add up
+ * to capacity exactly; every queue takes at least one task
+ */
+static size_t queueShare(size_t capacity, int i, int count)
+{
+    size_t share = capacity / (size_t) count + ((size_t) i < capacity % (size_t) count ? 1 : 0);
+    return share > 0 ? share : 1;
+}
+
+/*
+ * one ring per distinct node the workers run on, allocated on that node
+ */
+static int initRings(scheduler *sched, size_t capacity, const int *worker_node)
+{
+    int nodes[CPU_NODES_MAX], num_nodes = 0;
+
+    sched->worker_ring = calloc(sched->num_workers, sizeof(int));
+    if (sched->worker_ring == NULL) {
+        return -1;
+    }
+    for (int i = 0; worker_node != NULL && i < sched->num_workers; i++) {
+        int ring = 0;
+        while (ring < num_nodes && nodes[ring] != worker_node[i]) {
+            ring++;
+        }
+        if (ring == num_nodes && num_nodes < CPU_NODES_MAX) {
+            nodes[num_nodes++] = worker_node[i];
+        }
+        sched->worker_ring[i] = ring < CPU_NODES_MAX ? ring : 0;
+    }
+    if (num_nodes < 2) {
+        // everyone on one node (or unknown): a single ring, placed anywhere
+        num_nodes = 1;
+        nodes[0] = -1;
+        memset(sched->worker_ring, 0, sched->num_workers * sizeof(int));
+    }
+
+    sched->num_rings = num_nodes;
+    sched->central = aligned_alloc(CACHE_LINE_SIZE, num_nodes * sizeof(mpmc_ring));
+    if (sched->central == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        if (mpmcRingInitOnNode(&sched->central[i], queueShare(capacity, i, num_nodes), nodes[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int schedulerInit(scheduler *sched, schedule_mode mode, int num_workers, size_t capacity, const int *worker_node)
+{
+    sched->mode = mode;
+    sched->num_workers = num_workers;
+    sched->chunk = 1;
+    sched->guided = false;
+    sched->central = NULL;
+    sched->num_rings = 0;
+    sched->worker_ring = NULL;
+    atomic_init(&sched->next_ring, 0);
+    sched->workers = NULL;
+    atomic_init(&sched->next_worker, 0);
+
+    if (mode == SCHEDULE_FIFO) {
+        return initRings(sched, capacity, worker_node);
+    }
+    if (mode == SCHEDULE_LPT) {
+        return taskHeapInit(&sched->ready, capacity);
+    }
+
+    sched->workers = aligned_alloc(CACHE_LINE_SIZE, num_workers * sizeof(steal_worker));
+    if (sched->workers == NULL || epochInit(&sched->epoch, num_workers) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        steal_worker *w = &sched->workers[i];
+        // the inboxes together hold as much as the central ring would
+        int node = worker_node != NULL ? worker_node[i] : -1;
+        if (mpmcRingInitOnNode(&w->inbox, queueShare(capacity, i, num_workers), node) != 0 || wsDequeInit(&w->deque, DEQUE_INITIAL_CAPACITY, &sched->epoch, i) != 0) {
+            return -1;
+        }
+        w->random_state = 2463534242u + (unsigned) i * 2654435761u;
+    }
+    return 0;
+}
+
+void schedulerDestroy(scheduler *sched)
+{
+    if (sched->mode == SCHEDULE_FIFO) {
+        for (int i = 0; i < sched->num_rings; i++) {
+            mpmcRingDestroy(&sched->central[i]);
+        }
+        free(sched->central);
+        free(sched->worker_ring);
+        sched->central = NULL;
+        return;
+    }
+    if (sched->mode == SCHEDULE_LPT) {
+        taskHeapDestroy(&sched->ready);
+        return;
+    }
+    for (int i = 0; i < sched->num_workers; i++) {
+        mpmcRingDestroy(&sched->workers[i].inbox);
+        wsDequeDestroy(&sched->workers[i].deque);
+    }
+    free(sched->workers);
+    sched->workers = NULL;
+    epochDestroy(&sched->epoch);
+}
+
+bool schedulerTryPush(scheduler *sched, const task *item)
+{
+    if (sched->mode == SCHEDULE_FIFO) {
+        // round-robin over the node rings, skipping full ones
+        for (int tries = 0; tries < sched->num_rings; tries++) {
+            int target = atomic_load_explicit(&sched->next_ring, memory_order_relaxed);
+            atomic_store_explicit(&sched->next_ring, (target + 1) % sched->num_rings, memory_order_relaxed);
+            if (mpmcRingTryPush(&sched->central[target], item)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (sched->mode == SCHEDULE_LPT) {
+        return taskHeapTryPush(&sched->ready, item);
+    }
+
+    // round-robin, skipping inboxes that are full
+    for (int tries = 0; tries < sched->num_workers; tries++) {
+        int target = atomic_load_explicit(&sched->next_worker, memory_order_relaxed);
+        atomic_store_explicit(&sched->next_worker, (target + 1) % sched->num_workers, memory_order_relaxed);
+        if (mpmcRingTryPush(&sched->workers[target].inbox, item)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static unsigned xorshift(unsigned *state)
+{
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* tasks in a deque; exact for its owner, a hint for anyone else */
+static size_t dequeSize(ws_deque *deque)
+{
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    return (size_t) (bottom > top ? bottom - top : 0);
+}
+
+static bool stealPop(scheduler *sched, int worker, task *item)
+{
+    steal_worker *self = &sched->workers[worker];
+    task incoming;
+
+    if (wsDequePop(&self->deque, item)) {
+        return true;
+    }
+
+    // make what was dealt to us stealable, then work on the newest task;
+    // the deque takes at most an inbox worth so the queues stay bounded
+    while (dequeSize(&self->deque) < self->inbox.limit && mpmcRingTryPop(&self->inbox, &incoming)) {
+        if (!wsDequePush(&self->deque, &incoming)) {
+            // deque cannot grow: run this one directly
+            *item = incoming;
+            return true;
+        }
+    }
+    if (wsDequePop(&self->deque, item)) {
+        return true;
+    }
+
+    // sweep every other worker once, starting at a random victim;
+    // the epoch keeps the victims' deque buffers alive while we read them
+    int n = sched->num_workers;
+    int start = (int) (xorshift(&self->random_state) % (unsigned) n);
+    bool found = false;
+    epochEnter(&sched->epoch, worker);
+    for (int i = 0; i < n && !found; i++) {
+        int victim = (start + i) % n;
+        if (victim == worker) {
+            continue;
+        }
+        found = wsDequeSteal(&sched->workers[victim].deque, item)
+                || mpmcRingTryPop(&sched->workers[victim].inbox, item);
+    }
+    epochExit(&sched->epoch, worker);
+    // idle time is a good moment to free our own retired buffers
+    epochCollect(&sched->epoch, worker);
+    return found;
+}
+
+/*
+ * the worker's own node ring first, then the others
+ */
+static size_t fifoPop(scheduler *sched, int worker, task *items, size_t want)
+{
+    int home = sched->worker_ring[worker];
+    for (int i = 0; i < sched->num_rings; i++) {
+        mpmc_ring *ring = &sched->central[(home + i) % sched->num_rings];
+        size_t count = want == 1 ? (mpmcRingTryPop(ring, items) ? 1 : 0) : mpmcRingTryPopBatch(ring, items, want);
+        if (count > 0) {
+            return count;
+        }
+    }
+    return 0;
+}
+
+size_t schedulerTryPopBatch(scheduler *sched, int worker, task *items, size_t max)
+{
+    if (sched->mode == SCHEDULE_STEAL) {
+        // inboxes already move to the deques in bulk
+        return stealPop(sched, worker, items) ? 1 : 0;
+    }
+
+    size_t want = sched->chunk;
+    if (sched->guided) {
+        // like OpenMP's guided schedule: a share of what is left, never below the minimum
+        size_t share = (schedulerBacklog(sched) + sched->num_workers - 1) / sched->num_workers;
+        if (share > want) {
+            want = share;
+        }
+    }
+    if (want > max) {
+        want = max;
+    }
+    return schedulerTryPopUpTo(sched, worker, items, want);
+}
+
+size_t schedulerTryPopUpTo(scheduler *sched, int worker, task *items, size_t want)
+{
+    if (sched->mode == SCHEDULE_LPT) {
+        return taskHeapTryPopBatch(&sched->ready, items, want);
+    }
+    if (sched->mode == SCHEDULE_FIFO) {
+        return fifoPop(sched, worker, items, want);
+    }
+    size_t count = 0;
+    while (count < want && stealPop(sched, worker, &items[count])) {
+        count++;
+    }
+    return count;
+}
+
+size_t schedulerBacklog(scheduler *sched)
+{
+    size_t backlog = 0;
+    if (sched->mode == SCHEDULE_FIFO) {
+        for (int i = 0; i < sched->num_rings; i++) {
+            backlog += mpmcRingSize(&sched->central[i]);
+        }
+        return backlog;
+    }
+    if (sched->mode == SCHEDULE_LPT) {
+        return taskHeapSize(&sched->ready);
+    }
+    for (int i = 0; i < sched->num_workers; i++) {
+        backlog += mpmcRingSize(&sched->workers[i].inbox) + dequeSize(&sched->workers[i].deque);
+    }
+    return backlog;
+}
+
+size_t schedulerCapacity(scheduler *sched)
+{
+    size_t capacity = 0;
+    if (sched->mode == SCHEDULE_FIFO) {
+        for (int i = 0; i < sched->num_rings; i++) {
+            capacity += sched->central[i].limit;
+        }
+        return capacity;
+    }
+    if (sched->mode == SCHEDULE_LPT) {
+        return sched->ready.capacity;
+    }
+    for (int i = 0; i < sched->num_workers; i++) {
+        capacity += sched->workers[i].inbox.limit;
+    }
+    return capacity;
+}
+
+bool schedulerHasRoom(scheduler *sched)
+{
+    if (sched->mode == SCHEDULE_LPT) {
+        return taskHeapSize(&sched->ready) < sched->ready.capacity;
+    }
+    // any ring (fifo) or inbox (steal) with a free slot will take a push
+    int count = sched->mode == SCHEDULE_FIFO ? sched->num_rings : sched->num_workers;
+    for (int i = 0; i < count; i++) {
+        mpmc_ring *ring = sched->mode == SCHEDULE_FIFO ? &sched->central[i] : &sched->workers[i].inbox;
+        if (mpmcRingSize(ring) < ring->limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void schedulerClose(scheduler *sched)
+{
+    if (sched->mode == SCHEDULE_FIFO) {
+        for (int i = 0; i < sched->num_rings; i++) {
+            mpmcRingClose(&sched->central[i]);
+        }
+        return;
+    }
+    if (sched->mode == SCHEDULE_LPT) {
+        taskHeapClose(&sched->ready);
+        return;
+    }
+    for (int i = 0; i < sched->num_workers; i++) {
+        mpmcRingClose(&sched->workers[i].inbox);
+    }
+}
+
+bool schedulerIsClosed(scheduler *sched)
+{
+    if (sched->mode == SCHEDULE_FIFO) {
+        // rings are closed in order, so the last one decides
+        return mpmcRingIsClosed(&sched->central[sched->num_rings - 1]);
+    }
+    if (sched->mode == SCHEDULE_LPT) {
+        return taskHeapIsClosed(&sched->ready);
+    }
+    // inboxes are closed in order, so the last one decides
+    return mpmcRingIsClosed(&sched->workers[sched->num_workers - 1].inbox);
+}
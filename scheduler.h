@@ -0,0 +1,110 @@
+/*
+ * scheduler.h
+ *
+ * How tasks travel from the master to the workers:
+ *  - fifo:  one central lock-free ring shared by every worker, or one per
+ *           NUMA node when workers are placed on several nodes: the master
+ *           deals tasks round-robin over the node rings and workers drain
+ *           their own node's ring before looking at the others
+ *  - steal: the master deals tasks round-robin into per-worker inboxes, each
+ *           worker moves its inbox into a Chase-Lev deque and idle workers
+ *           steal from random victims
+ *  - lpt:   one central max-heap keyed on the task value, so workers always
+ *           start the longest ready task (longest processing time first)
+ * In fifo and lpt modes workers can claim several consecutive tasks per dequeue,
+ * either a fixed chunk or a guided one that shrinks with the backlog.
+ * Every mode is bounded: the master cannot push more than the capacity, and
+ * in steal mode a worker only refills its deque from its inbox while the
+ * deque holds less than an inbox, so at most twice the capacity is queued.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "cache_line.h"
+#include "epoch.h"
+#include "mpmc_ring.h"
+#include "task.h"
+#include "task_heap.h"
+#include "ws_deque.h"
+
+typedef enum {
+    SCHEDULE_FIFO,
+    SCHEDULE_STEAL,
+    SCHEDULE_LPT,
+} schedule_mode;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) ws_deque deque;
+    mpmc_ring inbox;
+    unsigned random_state; /* victim selection, owner only */
+} steal_worker;
+
+/* largest batch a worker may claim in one dequeue */
+#define SCHEDULE_MAX_CHUNK 256
+
+typedef struct {
+    schedule_mode mode;
+    int num_workers;
+    size_t chunk;             /* fixed chunk, or the smallest guided chunk */
+    bool guided;
+    mpmc_ring *central;       /* fifo: one ring per node */
+    int num_rings;
+    int *worker_ring;         /* fifo: ring index of each worker */
+    atomic_int next_ring;     /* fifo: round-robin cursor, masters may race on it */
+    steal_worker *workers;    /* steal */
+    epoch_domain epoch;       /* steal: reclaims grown deque buffers */
+    atomic_int next_worker;   /* steal: round-robin cursor, masters may race on it */
+    task_heap ready;          /* lpt */
+} scheduler;
+
+/* returns false if the name matches no mode */
+bool scheduleModeParse(const char *name, schedule_mode *mode);
+/*
+ * parse "N", "guided" or "guided:N" (N is the minimum guided chunk)
+ * returns false on malformed input or N outside 1..SCHEDULE_MAX_CHUNK
+ */
+bool scheduleChunkParse(const char *text, size_t *chunk, bool *guided);
+
+/*
+ * set up a scheduler for num_workers workers queueing up to capacity tasks,
+ * split over the rings or inboxes with at least one task each
+ * worker_node gives the NUMA node of every worker, or NULL when placement is unknown
+ * returns 0 on success, -1 on allocation failure
+ */
+int schedulerInit(scheduler *sched, schedule_mode mode, int num_workers, size_t capacity, const int *worker_node);
+void schedulerDestroy(scheduler *sched);
+
+/* masters only, any number of them; returns false when the queues are full */
+bool schedulerTryPush(scheduler *sched, const task *item);
+
+/*
+ * worker (0-based) only; claim a batch sized by the chunking policy, at most max tasks
+ * returns how many tasks were stored in items, 0 when none could be found
+ */
+size_t schedulerTryPopBatch(scheduler *sched, int worker, task *items, size_t max);
+/*
+ * worker (0-based) only; claim up to want tasks, whatever the chunking policy,
+ * for a caller that sizes its own batches (a remote worker's request)
+ * returns how many tasks were stored in items, 0 when none could be found
+ */
+size_t schedulerTryPopUpTo(scheduler *sched, int worker, task *items, size_t want);
+
+/* number of queued tasks; only a hint while other threads are active */
+size_t schedulerBacklog(scheduler *sched);
+/*
+ * tasks the master can queue before pushes fail (inboxes only in steal mode):
+ * the requested capacity, or one per ring or inbox if that is more
+ */
+size_t schedulerCapacity(scheduler *sched);
+/* whether a push could succeed now; only a hint while workers are popping */
+bool schedulerHasRoom(scheduler *sched);
+
+/* mark that the master is done; queued tasks can still be popped */
+void schedulerClose(scheduler *sched);
+bool schedulerIsClosed(scheduler *sched);
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * stats.c
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+uint64_t statsNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+void statsInit(thread_stats *stats, const char *role, int thread_num)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->role = role;
+    stats->thread_num = thread_num;
+}
+
+void statsRecordLatency(thread_stats *stats, uint64_t ns)
+{
+    int bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    stats->latency[bucket]++;
+    stats->latency_count++;
+    stats->latency_sum_ns += ns;
+    if (ns > stats->latency_max_ns) {
+        stats->latency_max_ns = ns;
+    }
+}
+
+void occupancyInit(occupancy_log *log, uint64_t capacity, uint64_t interval_ns)
+{
+    log->capacity = capacity;
+    log->peak = 0;
+    log->interval_ns = interval_ns;
+    log->count = 0;
+}
+
+void occupancyRecord(occupancy_log *log, uint64_t at_ns, uint64_t queued)
+{
+    if (log->count == OCCUPANCY_SAMPLES) {
+        for (size_t i = 0; i < OCCUPANCY_SAMPLES / 2; i++) {
+            log->samples[i] = log->samples[2 * i];
+        }
+        log->count = OCCUPANCY_SAMPLES / 2;
+        log->interval_ns *= 2;
+    }
+    log->samples[log->count++] = (occupancy_sample) { .at_ns = at_ns, .queued = queued };
+    if (queued > log->peak) {
+        log->peak = queued;
+    }
+}
+
+bool statsFormatParse(const char *name, stats_format *format)
+{
+    if (strcmp(name, "json") == 0) {
+        *format = STATS_JSON;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = STATS_CSV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * upper bound of the histogram bucket holding the given quantile, capped at the maximum seen
+ */
+static uint64_t latencyQuantile(const thread_stats *stats, double q)
+{
+    uint64_t rank = (uint64_t) (q * (double) stats->latency_count), seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += stats->latency[i];
+        if (seen > rank) {
+            uint64_t bound = (uint64_t) 2 << i;
+            return bound < stats->latency_max_ns ? bound : stats->latency_max_ns;
+        }
+    }
+    return stats->latency_max_ns;
+}
+
+static void accumulate(thread_stats *total, const thread_stats *s)
+{
+    total->tasks += s->tasks;
+    total->busy_ns += s->busy_ns;
+    total->idle_ns += s->idle_ns;
+    total->waits += s->waits;
+    total->backoff_ns += s->backoff_ns;
+    total->contention += s->contention;
+    total->parks += s->parks;
+    total->latency_count += s->latency_count;
+    total->latency_sum_ns += s->latency_sum_ns;
+    if (s->latency_max_ns > total->latency_max_ns) {
+        total->latency_max_ns = s->latency_max_ns;
+    }
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        total->latency[i] += s->latency[i];
+    }
+    total->releases += s->releases;
+    total->release_jitter_sum_ns += s->release_jitter_sum_ns;
+    if (s->release_jitter_max_ns > total->release_jitter_max_ns) {
+        total->release_jitter_max_ns = s->release_jitter_max_ns;
+    }
+}
+
+static void printJson(FILE *out, const thread_stats *s)
+{
+    fprintf(out, "{\"thread\": %d, \"role\": \"%s\", \"tasks\": %llu, \"busy_ns\": %llu, \"idle_ns\": %llu, "
+                 "\"waits\": %llu, \"backoff_ns\": %llu, \"contention\": %llu, \"parks\": %llu, "
+                 "\"latency_ns\": {\"count\": %llu, \"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"max\": %llu, "
+                 "\"log2_histogram\": [",
+            s->thread_num, s->role, (unsigned long long) s->tasks, (unsigned long long) s->busy_ns,
+            (unsigned long long) s->idle_ns, (unsigned long long) s->waits, (unsigned long long) s->backoff_ns,
+            (unsigned long long) s->contention, (unsigned long long) s->parks, (unsigned long long) s->latency_count,
+            (unsigned long long) (s->latency_count ? s->latency_sum_ns / s->latency_count : 0),
+            (unsigned long long) latencyQuantile(s, 0.5), (unsigned long long) latencyQuantile(s, 0.99),
+            (unsigned long long) s->latency_max_ns);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        fprintf(out, "%s%llu", i ? ", " : "", (unsigned long long) s->latency[i]);
+    }
+    fprintf(out, "]}, \"release_jitter_ns\": {\"count\": %llu, \"mean\": %llu, \"max\": %llu}}",
+            (unsigned long long) s->releases,
+            (unsigned long long) (s->releases ? s->release_jitter_sum_ns / s->releases : 0),
+            (unsigned long long) s->release_jitter_max_ns);
+}
+
+static void printCsv(FILE *out, const thread_stats *s)
+{
+    fprintf(out, "%d,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            s->thread_num, s->role, (unsigned long long) s->tasks, (unsigned long long) s->busy_ns,
+            (unsigned long long) s->idle_ns, (unsigned long long) s->waits, (unsigned long long) s->backoff_ns,
+            (unsigned long long) s->contention, (unsigned long long) s->parks,
+            (unsigned long long) (s->latency_count ? s->latency_sum_ns / s->latency_count : 0),
+            (unsigned long long) latencyQuantile(s, 0.5), (unsigned long long) latencyQuantile(s, 0.99),
+            (unsigned long long) s->latency_max_ns, (unsigned long long) s->releases,
+            (unsigned long long) (s->releases ? s->release_jitter_sum_ns / s->releases : 0),
+            (unsigned long long) s->release_jitter_max_ns);
+}
+
+static void printScaleEvent(FILE *out, stats_format format, const scale_event *e)
+{
+    if (format == STATS_CSV) {
+        fprintf(out, "%llu,%s,%d,%d,%llu,%llu\n", (unsigned long long) e->at_ns, e->action, e->thread_num,
+                e->workers, (unsigned long long) e->backlog, (unsigned long long) e->latency_ns);
+        return;
+    }
+    fprintf(out, "{\"at_ns\": %llu, \"action\": \"%s\", \"thread\": %d, \"workers\": %d, "
+                 "\"backlog\": %llu, \"latency_ns\": %llu}",
+            (unsigned long long) e->at_ns, e->action, e->thread_num, e->workers,
+            (unsigned long long) e->backlog, (unsigned long long) e->latency_ns);
+}
+
+void statsPrint(FILE *out, stats_format format, const thread_stats *stats, int count,
+                const scale_event *events, size_t num_events, const occupancy_log *occupancy)
+{
+    thread_stats total;
+    statsInit(&total, "all", 0);
+    for (int i = 0; i < count; i++) {
+        accumulate(&total, &stats[i]);
+    }
+    // the master's task count is the same tasks again
+    total.tasks = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(stats[i].role, "worker") == 0) {
+            total.tasks += stats[i].tasks;
+        }
+    }
+
+    if (format == STATS_CSV) {
+        fprintf(out, "thread,role,tasks,busy_ns,idle_ns,waits,backoff_ns,contention,parks,"
+                     "latency_mean_ns,latency_p50_ns,latency_p99_ns,latency_max_ns,"
+                     "releases,release_jitter_mean_ns,release_jitter_max_ns\n");
+        for (int i = 0; i < count; i++) {
+            printCsv(out, &stats[i]);
+        }
+        printCsv(out, &total);
+        if (num_events > 0) {
+            fprintf(out, "\nat_ns,action,thread,workers,backlog,latency_ns\n");
+            for (size_t i = 0; i < num_events; i++) {
+                printScaleEvent(out, format, &events[i]);
+            }
+        }
+        if (occupancy != NULL) {
+            fprintf(out, "\nat_ns,queued,capacity\n");
+            for (size_t i = 0; i < occupancy->count; i++) {
+                fprintf(out, "%llu,%llu,%llu\n", (unsigned long long) occupancy->samples[i].at_ns,
+                        (unsigned long long) occupancy->samples[i].queued, (unsigned long long) occupancy->capacity);
+            }
+        }
+        return;
+    }
+
+    fprintf(out, "{\"threads\": [\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "  ");
+        printJson(out, &stats[i]);
+        fprintf(out, ",\n");
+    }
+    fprintf(out, "  ");
+    printJson(out, &total);
+    fprintf(out, "\n]");
+    if (num_events > 0) {
+        fprintf(out, ", \"scaling\": [\n");
+        for (size_t i = 0; i < num_events; i++) {
+            fprintf(out, "  ");
+            printScaleEvent(out, format, &events[i]);
+            fprintf(out, "%s\n", i + 1 < num_events ? "," : "");
+        }
+        fprintf(out, "]");
+    }
+    if (occupancy != NULL) {
+        fprintf(out, ", \"queue\": {\"capacity\": %llu, \"peak\": %llu, \"interval_ns\": %llu, \"occupancy\": [",
+                (unsigned long long) occupancy->capacity, (unsigned long long) occupancy->peak,
+                (unsigned long long) occupancy->interval_ns);
+        for (size_t i = 0; i < occupancy->count; i++) {
+            fprintf(out, "%s[%llu, %llu]", i ? ", " : "", (unsigned long long) occupancy->samples[i].at_ns,
+                    (unsigned long long) occupancy->samples[i].queued);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "}\n");
+}
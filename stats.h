@@ -0,0 +1,92 @@
+/*
+ * stats.h
+ *
+ * Per-thread runtime counters, written only by their own thread and read
+ * after the join, so recording them costs no synchronization.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache_line.h"
+
+/* enqueue-to-start latency, bucket i counts latencies in [2^i, 2^(i+1)) ns */
+#define LATENCY_BUCKETS 48
+
+typedef enum {
+    STATS_JSON,
+    STATS_CSV,
+} stats_format;
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) const char *role; /* "master" or "worker" */
+    int thread_num;
+    uint64_t tasks;        /* enqueued by the master, run by a worker */
+    uint64_t busy_ns;      /* parsing and enqueuing / running tasks */
+    uint64_t idle_ns;      /* sleeping on wait records / looking for a task */
+    uint64_t waits;        /* times the queue was full / empty and the thread backed off */
+    uint64_t backoff_ns;   /* time spent backing off / spinning and parked */
+    uint64_t contention;   /* lost CAS races on the task queues */
+    uint64_t parks;        /* worker: times it parked / master: parked workers it woke */
+    uint64_t latency_count;
+    uint64_t latency_sum_ns;
+    uint64_t latency_max_ns;
+    uint64_t latency[LATENCY_BUCKETS];
+    uint64_t releases;     /* master: wait deadlines reached */
+    uint64_t release_jitter_sum_ns;
+    uint64_t release_jitter_max_ns;
+} thread_stats;
+
+/* a decision of the elastic worker pool */
+typedef struct {
+    uint64_t at_ns;        /* since the run started */
+    const char *action;    /* "spawn" or "retire" */
+    int thread_num;
+    int workers;           /* active workers after the decision */
+    uint64_t backlog;      /* queued tasks when it was taken */
+    uint64_t latency_ns;   /* latest enqueue-to-start latency seen */
+} scale_event;
+
+/*
+ * queued tasks over the whole run in constant memory: a sample every
+ * interval_ns, and when the samples run out every other one is dropped and
+ * the interval doubles
+ */
+#define OCCUPANCY_SAMPLES 512
+
+typedef struct {
+    uint64_t at_ns;        /* since the run started */
+    uint64_t queued;
+} occupancy_sample;
+
+typedef struct {
+    uint64_t capacity;     /* of the task queues */
+    uint64_t peak;
+    uint64_t interval_ns;
+    size_t count;
+    occupancy_sample samples[OCCUPANCY_SAMPLES];
+} occupancy_log;
+
+uint64_t statsNowNs(void);
+
+void statsInit(thread_stats *stats, const char *role, int thread_num);
+void statsRecordLatency(thread_stats *stats, uint64_t ns);
+
+void occupancyInit(occupancy_log *log, uint64_t capacity, uint64_t interval_ns);
+/* the sampler then waits log->interval_ns before the next sample */
+void occupancyRecord(occupancy_log *log, uint64_t at_ns, uint64_t queued);
+
+/* returns false if the name matches no format */
+bool statsFormatParse(const char *name, stats_format *format);
+/*
+ * dump every thread plus a totals row, then the scaling decisions if there are
+ * any and the queue occupancy if it was sampled (NULL otherwise)
+ */
+void statsPrint(FILE *out, stats_format format, const thread_stats *stats, int count,
+                const scale_event *events, size_t num_events, const occupancy_log *occupancy);
+
+#endif
@@ -8,6 +8,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "task_kernel.h"
+#include "task_reader.h"
+
 // aggregate variables
 long sum = 0;
 long odd = 0;
@@ -15,6 +18,10 @@ long min = INT_MAX;
 long max = INT_MIN;
 bool done = false;
 
+// simulated work per task
+task_kernel kernel;
+kernel_context context;
+
 // function prototypes
 void update(long number);
 
@@ -24,7 +31,7 @@ void update(long number);
 void update(long number)
 {
     // simulate computation
-    sleep(number);
+    taskKernelRun(&kernel, &context, number);
 
     // update aggregate variables
     sum += number;
@@ -42,27 +49,52 @@ void update(long number)
 int main(int argc, char* argv[])
 {
     // check and parse command line options
-    if (argc != 2) {
-        printf("Usage: sum <infile>\n");
+    const char *kernel_spec = "sleep";
+    int opt;
+    while ((opt = getopt(argc, argv, "k:")) != -1) {
+        if (opt == 'k') {
+            kernel_spec = optarg;
+        } else {
+            printf("Usage: sum [-k kernel] <infile>\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (argc - optind != 1) {
+        printf("Usage: sum [-k kernel] <infile>\n");
+        exit(EXIT_FAILURE);
+    }
+    char *fn = argv[optind];
+
+    if (taskKernelOpen(&kernel, kernel_spec) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (kernelContextInit(&context, &kernel) != 0) {
+        printf("ERROR: Cannot allocate kernel buffers\n");
         exit(EXIT_FAILURE);
     }
-    char *fn = argv[1];
 
     // load numbers and add them to the queue
-    FILE* fin = fopen(fn, "r");
-    char action;
-    long num;
-    while (fscanf(fin, "%c %ld\n", &action, &num) == 2) {
-        if (action == 'p') {            // process
-            update(num);
-        } else if (action == 'w') {     // wait
-            sleep(num);
-        } else {
-            printf("ERROR: Unrecognized action: '%c'\n", action);
-            exit(EXIT_FAILURE);
+    task_reader fin;
+    task_record record;
+    int status;
+    if (taskReaderOpen(&fin, fn) != 0) {
+        printf("ERROR: Cannot open '%s'\n", fn);
+        exit(EXIT_FAILURE);
+    }
+    while ((status = taskReaderNext(&fin, &record)) > 0) {
+        if (record.op == TASK_PROCESS) {        // process
+            update(record.value);
+        } else {                                // wait
+            sleep(record.value);
         }
     }
-    fclose(fin);
+    taskReaderClose(&fin);
+    if (status < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    kernelContextDestroy(&context);
+    taskKernelClose(&kernel);
 
     // print results
     printf("%ld %ld %ld %ld\n", sum, odd, min, max);
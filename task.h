@@ -0,0 +1,17 @@
+/*
+ * task.h
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+
+/* A unit of work handed from the master to the workers */
+typedef struct {
+    long value;
+    uint64_t enqueued_ns; /* monotonic push time, only set with --stats */
+    uint64_t epoch;       /* checkpoint epoch, only set with --checkpoint */
+} task;
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * task_convert.c
+ *
+ * converts task files between the text format ("p 10" per line) and the
+ * binary format described in task_format.h; the direction follows the input
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "task_format.h"
+#include "task_reader.h"
+
+/* op codes used when writing binary files */
+static const char binary_ops[] = { TASK_PROCESS, TASK_WAIT, '\0' };
+#define NUM_BINARY_OPS (sizeof(binary_ops) - 1)
+
+static void writeBinaryHeader(FILE *out, uint64_t record_count)
+{
+    unsigned char header[TASK_BINARY_FIXED_HEADER + 8] = { 0 };
+    size_t size = taskBinaryHeaderSize(NUM_BINARY_OPS);
+
+    memcpy(header, TASK_BINARY_MAGIC, TASK_BINARY_MAGIC_SIZE);
+    storeLe16(header + 4, TASK_BINARY_VERSION);
+    storeLe16(header + 6, NUM_BINARY_OPS);
+    storeLe64(header + 8, record_count);
+    memcpy(header + TASK_BINARY_FIXED_HEADER, binary_ops, NUM_BINARY_OPS);
+    fwrite(header, 1, size, out);
+}
+
+static int toBinary(task_reader *in, FILE *out)
+{
+    task_record record;
+    uint64_t count = 0;
+    int status;
+
+    // the record count is patched in once everything was written
+    writeBinaryHeader(out, 0);
+    while ((status = taskReaderNext(in, &record)) > 0) {
+        unsigned char packed[TASK_BINARY_RECORD_SIZE];
+
+        if (record.value < INT32_MIN || record.value > INT32_MAX) {
+            fprintf(stderr, "%s:%ld: value %ld does not fit in 32 bits\n", in->path, in->line_number, record.value);
+            return -1;
+        }
+        packed[0] = (unsigned char) (strchr(binary_ops, record.op) - binary_ops);
+        storeLe32(packed + 1, (uint32_t) (int32_t) record.value);
+        fwrite(packed, 1, sizeof(packed), out);
+        count++;
+    }
+    if (status < 0) {
+        return -1;
+    }
+    if (fseek(out, 0, SEEK_SET) != 0) {
+        perror("fseek");
+        return -1;
+    }
+    writeBinaryHeader(out, count);
+    return 0;
+}
+
+static int toText(task_reader *in, FILE *out)
+{
+    task_record record;
+    int status;
+
+    while ((status = taskReaderNext(in, &record)) > 0) {
+        fprintf(out, "%c %ld\n", record.op, record.value);
+    }
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    task_reader in;
+    FILE *out;
+    int status;
+
+    if (argc != 3) {
+        printf("Usage: task_convert <infile> <outfile>\n"
+               "Text input is written as binary, binary input as text.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (taskReaderOpen(&in, argv[1]) != 0) {
+        fprintf(stderr, "Error opening file '%s': %s\n", argv[1], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    out = fopen(argv[2], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Error opening file '%s': %s\n", argv[2], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    status = in.format == TASK_FORMAT_TEXT ? toBinary(&in, out) : toText(&in, out);
+    taskReaderClose(&in);
+    if (fclose(out) != 0 || status < 0) {
+        fprintf(stderr, "Conversion of '%s' failed\n", argv[1]);
+        remove(argv[2]);
+        exit(EXIT_FAILURE);
+    }
+    return (EXIT_SUCCESS);
+}
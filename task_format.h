@@ -0,0 +1,69 @@
+/*
+ * task_format.h
+ *
+ * Binary task file layout (all integers little-endian):
+ *
+ *   0   4 bytes  magic "MWTB"
+ *   4   u16      version (TASK_BINARY_VERSION)
+ *   6   u16      number of op codes N
+ *   8   u64      number of records
+ *   16  N bytes  op table: the text action ('p', 'w', ...) of each op code,
+ *                zero-padded to a multiple of 8
+ *   ..  records  TASK_BINARY_RECORD_SIZE bytes each: u8 op code, i32 value
+ *
+ * Records are fixed width, so a mapped file is indexed directly instead of parsed.
+ */
+
+#ifndef TASK_FORMAT_H
+#define TASK_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TASK_BINARY_MAGIC "MWTB"
+#define TASK_BINARY_MAGIC_SIZE 4
+#define TASK_BINARY_VERSION 1
+#define TASK_BINARY_FIXED_HEADER 16
+#define TASK_BINARY_RECORD_SIZE 5
+
+static inline uint16_t loadLe16(const unsigned char *p)
+{
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static inline uint32_t loadLe32(const unsigned char *p)
+{
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline uint64_t loadLe64(const unsigned char *p)
+{
+    return (uint64_t) loadLe32(p) | (uint64_t) loadLe32(p + 4) << 32;
+}
+
+static inline void storeLe16(unsigned char *p, uint16_t v)
+{
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+}
+
+static inline void storeLe32(unsigned char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+static inline void storeLe64(unsigned char *p, uint64_t v)
+{
+    storeLe32(p, (uint32_t) v);
+    storeLe32(p + 4, (uint32_t) (v >> 32));
+}
+
+/* size of the header for an op table of n entries */
+static inline size_t taskBinaryHeaderSize(size_t op_count)
+{
+    return TASK_BINARY_FIXED_HEADER + ((op_count + 7) & ~(size_t) 7);
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * task_heap.c
+ */
+
+#include <stdlib.h>
+
+#include "mpmc_ring.h"
+#include "task_heap.h"
+
+int taskHeapInit(task_heap *heap, size_t capacity)
+{
+    heap->items = malloc(capacity * sizeof(task));
+    if (heap->items == NULL || pthread_mutex_init(&heap->lock, NULL) != 0) {
+        free(heap->items);
+        return -1;
+    }
+    heap->capacity = capacity;
+    atomic_init(&heap->size, 0);
+    atomic_init(&heap->closed, false);
+    return 0;
+}
+
+void taskHeapDestroy(task_heap *heap)
+{
+    pthread_mutex_destroy(&heap->lock);
+    free(heap->items);
+    heap->items = NULL;
+}
+
+/*
+ * take the lock, counting a busy lock as contention like the lock-free queues do
+ */
+static void heapLock(task_heap *heap)
+{
+    if (pthread_mutex_trylock(&heap->lock) != 0) {
+        mpmc_contention++;
+        pthread_mutex_lock(&heap->lock);
+    }
+}
+
+bool taskHeapTryPush(task_heap *heap, const task *item)
+{
+    heapLock(heap);
+    size_t i = atomic_load_explicit(&heap->size, memory_order_relaxed);
+    if (i == heap->capacity) {
+        pthread_mutex_unlock(&heap->lock);
+        return false;
+    }
+    // sift up from the new leaf
+    while (i > 0 && heap->items[(i - 1) / 2].value < item->value) {
+        heap->items[i] = heap->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->items[i] = *item;
+    atomic_fetch_add_explicit(&heap->size, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&heap->lock);
+    return true;
+}
+
+/*
+ * remove the root of a non-empty heap of size tasks
+ */
+static task popRoot(task *items, size_t size)
+{
+    task top = items[0];
+    task last = items[--size];
+    size_t i = 0;
+    // sift the last leaf down from the root
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && items[child + 1].value > items[child].value) {
+            child++;
+        }
+        if (items[child].value <= last.value) {
+            break;
+        }
+        items[i] = items[child];
+        i = child;
+    }
+    items[i] = last;
+    return top;
+}
+
+size_t taskHeapTryPopBatch(task_heap *heap, task *items, size_t max)
+{
+    // skip the lock when there is obviously nothing to take
+    if (atomic_load_explicit(&heap->size, memory_order_relaxed) == 0) {
+        return 0;
+    }
+    heapLock(heap);
+    size_t size = atomic_load_explicit(&heap->size, memory_order_relaxed);
+    size_t count = 0;
+    while (count < max && size > 0) {
+        items[count++] = popRoot(heap->items, size--);
+    }
+    atomic_store_explicit(&heap->size, size, memory_order_relaxed);
+    pthread_mutex_unlock(&heap->lock);
+    return count;
+}
+
+size_t taskHeapSize(task_heap *heap)
+{
+    return atomic_load_explicit(&heap->size, memory_order_relaxed);
+}
+
+void taskHeapClose(task_heap *heap)
+{
+    atomic_store_explicit(&heap->closed, true, memory_order_release);
+}
+
+bool taskHeapIsClosed(task_heap *heap)
+{
+    return atomic_load_explicit(&heap->closed, memory_order_acquire);
+}
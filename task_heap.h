@@ -0,0 +1,47 @@
+/*
+ * task_heap.h
+ *
+ * Bounded max-heap of tasks keyed on their value, shared by the master and
+ * every worker. A binary heap has no lock-free form that beats a lock at
+ * these sizes, so one mutex guards it; the operations are O(log n) and the
+ * critical sections short. Workers pop the longest ready tasks first.
+ */
+
+#ifndef TASK_HEAP_H
+#define TASK_HEAP_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache_line.h"
+#include "task.h"
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+    task *items;                                  /* items[0] holds the largest value */
+    size_t capacity;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t size; /* written under the lock, read anywhere */
+    _Alignas(CACHE_LINE_SIZE) atomic_bool closed; /* no more pushes will happen */
+} task_heap;
+
+/* returns 0 on success, -1 if the items could not be allocated */
+int taskHeapInit(task_heap *heap, size_t capacity);
+void taskHeapDestroy(task_heap *heap);
+
+/* returns false when the heap is full */
+bool taskHeapTryPush(task_heap *heap, const task *item);
+/*
+ * take up to max tasks, largest value first
+ * returns how many were copied into items, 0 when the heap is empty
+ */
+size_t taskHeapTryPopBatch(task_heap *heap, task *items, size_t max);
+/* number of queued tasks; only a hint while other threads are active */
+size_t taskHeapSize(task_heap *heap);
+
+/* mark that the producer is done; pending tasks can still be popped */
+void taskHeapClose(task_heap *heap);
+bool taskHeapIsClosed(task_heap *heap);
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * task_kernel.c
+ */
+
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "task_kernel.h"
+
+#define SPIN_DEFAULT_US 1000
+#define STREAM_DEFAULT_KB 1024
+/* per-thread stream buffer, well beyond a last-level cache */
+#define STREAM_BUFFER_BYTES (64UL << 20)
+#define CALIBRATION_NS 20000000L
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/* splitmix64 step: cheap, serial and impossible to vectorize away */
+static uint64_t spin(uint64_t state, uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15u);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+        state = z ^ (z >> 31);
+    }
+    return state;
+}
+
+/*
+ * measure how many spin iterations fit in a microsecond on this machine
+ */
+static uint64_t calibrateSpin(void)
+{
+    uint64_t iterations = 1024, elapsed, start;
+    volatile uint64_t sink;
+
+    for (;;) {
+        start = nowNs();
+        sink = spin(start, iterations);
+        elapsed = nowNs() - start;
+        if (elapsed >= CALIBRATION_NS) {
+            break;
+        }
+        iterations *= 2;
+    }
+    (void) sink;
+    uint64_t per_us = iterations * 1000 / elapsed;
+    return per_us > 0 ? per_us : 1;
+}
+
+/*
+ * parse the optional ":N" suffix of a kernel name
+ * returns false if it is present and not a positive number
+ */
+static bool parseUnit(const char *suffix, long fallback, long *unit)
+{
+    char *end;
+
+    if (*suffix == '\0') {
+        *unit = fallback;
+        return true;
+    }
+    if (*suffix != ':') {
+        return false;
+    }
+    *unit = strtol(suffix + 1, &end, 10);
+    return end != suffix + 1 && *end == '\0' && *unit > 0;
+}
+
+static int openShared(task_kernel *kernel, const char *path)
+{
+    int (*init)(void);
+
+    kernel->library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (kernel->library == NULL) {
+        fprintf(stderr, "Cannot load kernel: %s\n", dlerror());
+        return -1;
+    }
+    *(void **) &kernel->shared_run = dlsym(kernel->library, "task_kernel_run");
+    if (kernel->shared_run == NULL) {
+        fprintf(stderr, "Kernel '%s' has no task_kernel_run symbol\n", path);
+        dlclose(kernel->library);
+        return -1;
+    }
+    *(void **) &init = dlsym(kernel->library, "task_kernel_init");
+    if (init != NULL && init() != 0) {
+        fprintf(stderr, "Kernel '%s' failed to initialize\n", path);
+        dlclose(kernel->library);
+        return -1;
+    }
+    return 0;
+}
+
+int taskKernelOpen(task_kernel *kernel, const char *spec)
+{
+    memset(kernel, 0, sizeof(*kernel));
+
+    if (strcmp(spec, "sleep") == 0) {
+        kernel->kind = KERNEL_SLEEP;
+    } else if (strcmp(spec, "none") == 0) {
+        kernel->kind = KERNEL_NONE;
+    } else if (strncmp(spec, "spin", 4) == 0 && parseUnit(spec + 4, SPIN_DEFAULT_US, &kernel->unit)) {
+        kernel->kind = KERNEL_SPIN;
+        kernel->spins_per_us = calibrateSpin();
+    } else if (strncmp(spec, "stream", 6) == 0 && parseUnit(spec + 6, STREAM_DEFAULT_KB, &kernel->unit)) {
+        kernel->kind = KERNEL_STREAM;
+    } else if (strncmp(spec, "so:", 3) == 0) {
+        kernel->kind = KERNEL_SHARED;
+        return openShared(kernel, spec + 3);
+    } else {
+        fprintf(stderr, "Unknown kernel: '%s'. Expected value: sleep, spin[:US], stream[:KB], none or so:PATH\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+void taskKernelClose(task_kernel *kernel)
+{
+    if (kernel->library != NULL) {
+        dlclose(kernel->library);
+        kernel->library = NULL;
+    }
+}
+
+int kernelContextInit(kernel_context *context, const task_kernel *kernel)
+{
+    memset(context, 0, sizeof(*context));
+    if (kernel->kind == KERNEL_STREAM) {
+        context->length = STREAM_BUFFER_BYTES / sizeof(uint64_t);
+        context->buffer = malloc(STREAM_BUFFER_BYTES);
+        if (context->buffer == NULL) {
+            return -1;
+        }
+        // touch every page now so the first tasks do not pay for faults
+        for (size_t i = 0; i < context->length; i++) {
+            context->buffer[i] = i;
+        }
+    }
+    return 0;
+}
+
+void kernelContextDestroy(kernel_context *context)
+{
+    free(context->buffer);
+    context->buffer = NULL;
+}
+
+/*
+ * read-modify-write words of the buffer cyclically
+ */
+static void stream(kernel_context *context, size_t words)
+{
+    uint64_t sum = context->sink;
+    size_t position = context->position;
+
+    while (words > 0) {
+        size_t run = context->length - position;
+        if (run > words) {
+            run = words;
+        }
+        uint64_t *p = context->buffer + position;
+        for (size_t i = 0; i < run; i++) {
+            p[i] = p[i] * 3 + 1;
+            sum += p[i];
+        }
+        words -= run;
+        position = (position + run) % context->length;
+    }
+    context->position = position;
+    context->sink = sum;
+}
+
+void taskKernelRun(const task_kernel *kernel, kernel_context *context, long units)
+{
+    if (units <= 0) {
+        return;
+    }
+    switch (kernel->kind) {
+        case KERNEL_SLEEP:
+            sleep((unsigned) units);
+            break;
+        case KERNEL_SPIN:
+            context->sink = spin(context->sink, (uint64_t) units * (uint64_t) kernel->unit * kernel->spins_per_us);
+            break;
+        case KERNEL_STREAM:
+            stream(context, (size_t) units * (size_t) kernel->unit * 1024 / sizeof(uint64_t));
+            break;
+        case KERNEL_SHARED:
+            kernel->shared_run(units);
+            break;
+        case KERNEL_NONE:
+            break;
+    }
+}
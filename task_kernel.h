@@ -0,0 +1,61 @@
+/*
+ * task_kernel.h
+ *
+ * The work a task simulates for its value ("units"):
+ *  - sleep      sleep for units seconds (the original behavior)
+ *  - spin[:US]  hash in a loop for units * US microseconds of CPU time,
+ *               calibrated at startup (default 1000us per unit)
+ *  - stream[:KB] read and write units * KB KiB of a per-thread buffer larger
+ *               than the caches (default 1024KiB per unit)
+ *  - none       no work at all, only the aggregation
+ *  - so:PATH    call task_kernel_run(long units) from a shared object; an
+ *               optional int task_kernel_init(void) runs once at load and
+ *               must return 0
+ * The aggregation does not depend on the kernel, so results stay comparable.
+ */
+
+#ifndef TASK_KERNEL_H
+#define TASK_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    KERNEL_SLEEP,
+    KERNEL_SPIN,
+    KERNEL_STREAM,
+    KERNEL_NONE,
+    KERNEL_SHARED,
+} kernel_kind;
+
+typedef struct {
+    kernel_kind kind;
+    long unit;                      /* spin: microseconds, stream: KiB */
+    uint64_t spins_per_us;          /* spin calibration */
+    void *library;                  /* so: dlopen handle */
+    void (*shared_run)(long units); /* so: entry point */
+} task_kernel;
+
+/* per-thread scratch state of a kernel */
+typedef struct {
+    uint64_t *buffer; /* stream */
+    size_t length;
+    size_t position;
+    uint64_t sink;    /* keeps the compiler from dropping the work */
+} kernel_context;
+
+/*
+ * set up the kernel described by spec (see above)
+ * returns 0 on success, -1 after printing the reason to stderr
+ */
+int taskKernelOpen(task_kernel *kernel, const char *spec);
+void taskKernelClose(task_kernel *kernel);
+
+/* returns 0 on success, -1 on allocation failure */
+int kernelContextInit(kernel_context *context, const task_kernel *kernel);
+void kernelContextDestroy(kernel_context *context);
+
+/* simulate a task of the given size; units <= 0 do nothing */
+void taskKernelRun(const task_kernel *kernel, kernel_context *context, long units);
+
+#endif
@@ -0,0 +1,520 @@
+/*
+ * task_reader.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#include "task_format.h"
+#include "task_reader.h"
+
+#define SCAN_BLOCK 64
+/* consumed input is dropped from the mapping in steps of this size */
+#define RELEASE_STEP (64UL << 20)
+
+/*
+ * bit i of the result is set when p[i] is a newline, for i < length <= 64
+ */
+static uint64_t newlineMaskScalar(const char *p, size_t length)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length; i++) {
+        mask |= (uint64_t) (p[i] == '\n') << i;
+    }
+    return mask;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static uint64_t newlineMaskSse2(const char *p)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (p + 16 * i));
+        mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)) << (16 * i);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t newlineMaskAvx2(const char *p)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i low = _mm256_loadu_si256((const __m256i *) p);
+    __m256i high = _mm256_loadu_si256((const __m256i *) (p + 32));
+    uint32_t low_mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline));
+    uint32_t high_mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline));
+    return (uint64_t) high_mask << 32 | low_mask;
+}
+#endif
+
+static uint64_t newlineMaskFull(const char *p)
+{
+    return newlineMaskScalar(p, SCAN_BLOCK);
+}
+
+/* scanner for whole 64-byte blocks, chosen once on the first open */
+static uint64_t (*newline_mask)(const char *p);
+
+static void selectScanner(void)
+{
+    newline_mask = newlineMaskFull;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        newline_mask = newlineMaskAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        newline_mask = newlineMaskSse2;
+    }
+#endif
+}
+
+static uint64_t scanBlock(const task_reader *reader)
+{
+    size_t length = reader->size - reader->block;
+    if (length >= SCAN_BLOCK) {
+        return newline_mask(reader->data + reader->block);
+    }
+    return newlineMaskScalar(reader->data + reader->block, length);
+}
+
+/*
+ * validate the header of a binary file and point the reader at its records
+ * returns 0 on success, -1 if the header is inconsistent with the file size
+ */
+static int openBinary(task_reader *reader)
+{
+    const unsigned char *header = (const unsigned char *) reader->data;
+    size_t header_size;
+
+    if (reader->size < TASK_BINARY_FIXED_HEADER || loadLe16(header + 4) != TASK_BINARY_VERSION) {
+        return -1;
+    }
+    reader->op_count = loadLe16(header + 6);
+    reader->record_count = loadLe64(header + 8);
+    header_size = taskBinaryHeaderSize(reader->op_count);
+    if (reader->op_count > sizeof(reader->ops) || reader->size < header_size
+        || reader->record_count != (reader->size - header_size) / TASK_BINARY_RECORD_SIZE
+        || (reader->size - header_size) % TASK_BINARY_RECORD_SIZE != 0) {
+        return -1;
+    }
+    memcpy(reader->ops, header + TASK_BINARY_FIXED_HEADER, reader->op_count);
+    reader->records = header + header_size;
+    reader->record_index = 0;
+    reader->format = TASK_FORMAT_BINARY;
+    return 0;
+}
+
+int taskReaderOpen(task_reader *reader, const char *path)
+{
+    struct stat info;
+    int fd;
+
+    if (newline_mask == NULL) {
+        selectScanner();
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    reader->path = path;
+    reader->size = (size_t) info.st_size;
+    reader->data = NULL;
+    if (reader->size > 0) {
+        void *data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        madvise(data, reader->size, MADV_SEQUENTIAL);
+        reader->data = data;
+    }
+    close(fd);
+
+    reader->format = TASK_FORMAT_TEXT;
+    if (reader->size >= TASK_BINARY_MAGIC_SIZE
+        && memcmp(reader->data, TASK_BINARY_MAGIC, TASK_BINARY_MAGIC_SIZE) == 0) {
+        if (openBinary(reader) != 0) {
+            taskReaderClose(reader);
+            errno = EINVAL;
+            return -1;
+        }
+        reader->released = 0;
+        reader->release_pages = true;
+        reader->segments = NULL;
+        return 0;
+    }
+
+    reader->cursor = 0;
+    reader->block = 0;
+    reader->newlines = reader->size > 0 ? scanBlock(reader) : 0;
+    reader->released = 0;
+    reader->release_pages = true;
+    reader->line_number = 0;
+    reader->segments = NULL;
+    return 0;
+}
+
+static void freeSegments(task_reader *reader)
+{
+    for (int i = 0; reader->segments != NULL && i < reader->num_segments; i++) {
+        free(reader->segments[i].records);
+    }
+    free(reader->segments);
+    reader->segments = NULL;
+}
+
+void taskReaderClose(task_reader *reader)
+{
+    freeSegments(reader);
+    if (reader->data != NULL) {
+        munmap((void *) reader->data, reader->size);
+        reader->data = NULL;
+    }
+}
+
+/*
+ * offset of the next newline at or after the cursor, or size if there is none
+ */
+static size_t nextNewline(task_reader *reader)
+{
+    while (reader->newlines == 0) {
+        reader->block += SCAN_BLOCK;
+        if (reader->block >= reader->size) {
+            reader->block = reader->size;
+            return reader->size;
+        }
+        reader->newlines = scanBlock(reader);
+    }
+    size_t position = reader->block + (size_t) __builtin_ctzll(reader->newlines);
+    reader->newlines &= reader->newlines - 1;
+    return position;
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*
+ * parse a signed decimal number in [p, end)
+ * returns a pointer past the last digit, or NULL if there is none or it overflows
+ */
+static const char * parseLong(const char *p, const char *end, long *value)
+{
+    bool negative = false;
+    unsigned long magnitude = 0, limit;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+    limit = negative ? (unsigned long) LONG_MAX + 1 : (unsigned long) LONG_MAX;
+    if (p == end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        unsigned digit = (unsigned) (*p - '0');
+        if (magnitude > (limit - digit) / 10) {
+            return NULL;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    *value = negative ? (long) (0 - magnitude) : (long) magnitude;
+    return p;
+}
+
+/*
+ * let the kernel drop pages that were already parsed, keeping RSS flat
+ */
+static void releaseConsumed(task_reader *reader)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t upto = reader->cursor & ~(page - 1);
+    if (upto - reader->released >= RELEASE_STEP) {
+        madvise((void *) (reader->data + reader->released), upto - reader->released, MADV_DONTNEED);
+        reader->released = upto;
+    }
+}
+
+static int nextBinary(task_reader *reader, task_record *record)
+{
+    if (reader->record_index == reader->record_count) {
+        return 0;
+    }
+    const unsigned char *p = reader->records + reader->record_index * TASK_BINARY_RECORD_SIZE;
+    reader->record_index++;
+    if (p[0] >= reader->op_count) {
+        fprintf(stderr, "%s: record %llu: unknown op code %u\n", reader->path,
+                (unsigned long long) reader->record_index, p[0]);
+        return -1;
+    }
+    record->op = reader->ops[p[0]];
+    if (record->op != TASK_PROCESS && record->op != TASK_WAIT) {
+        fprintf(stderr, "%s: record %llu: unrecognized action '%c'\n", reader->path,
+                (unsigned long long) reader->record_index, record->op);
+        return -1;
+    }
+    record->value = (int32_t) loadLe32(p + 1);
+
+    reader->cursor = (size_t) (p + TASK_BINARY_RECORD_SIZE - (const unsigned char *) reader->data);
+    if (reader->cursor - reader->released >= RELEASE_STEP) {
+        releaseConsumed(reader);
+    }
+    return 1;
+}
+
+/*
+ * hand out the records of the segments in file order
+ */
+static int nextParsed(task_reader *reader, task_record *record)
+{
+    while (reader->segment_index < reader->num_segments) {
+        task_segment *segment = &reader->segments[reader->segment_index];
+        if (reader->segment_next < segment->count) {
+            *record = segment->records[reader->segment_next++];
+            return 1;
+        }
+        if (segment->status != 0) {
+            return -1; // reported by the thread that parsed it
+        }
+        // done with this one: free it before moving on
+        free(segment->records);
+        segment->records = NULL;
+        reader->segment_index++;
+        reader->segment_next = 0;
+    }
+    return 0;
+}
+
+int taskReaderNext(task_reader *reader, task_record *record)
+{
+    if (reader->segments != NULL) {
+        return nextParsed(reader, record);
+    }
+    if (reader->format == TASK_FORMAT_BINARY) {
+        return nextBinary(reader, record);
+    }
+    while (reader->cursor < reader->size) {
+        const char *line = reader->data + reader->cursor;
+        size_t newline = nextNewline(reader);
+        const char *end = reader->data + newline;
+        const char *p = line;
+
+        reader->cursor = newline + 1;
+        reader->line_number++;
+
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+        if (p == end) {
+            continue; // blank line
+        }
+
+        record->op = *p++;
+        if (record->op != TASK_PROCESS && record->op != TASK_WAIT) {
+            fprintf(stderr, "%s:%ld: unrecognized action '%c'\n", reader->path, reader->line_number, record->op);
+            return -1;
+        }
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+        p = parseLong(p, end, &record->value);
+        while (p != NULL && p < end && isBlank(*p)) {
+            p++;
+        }
+        if (p != end) {
+            fprintf(stderr, "%s:%ld: expected a number after '%c'\n", reader->path, reader->line_number, record->op);
+            return -1;
+        }
+
+        if (reader->release_pages && reader->cursor - reader->released >= RELEASE_STEP) {
+            releaseConsumed(reader);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* below this many bytes per range, a parallel parse uses fewer threads */
+#define MIN_RANGE_SIZE (1UL << 20)
+
+typedef struct {
+    task_reader range;    /* a reader over whole lines of the parent's mapping */
+    task_segment *segment;
+    const char *start;
+    size_t length;
+} range_job;
+
+static uint64_t countNewlines(const char *p, size_t length)
+{
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + SCAN_BLOCK <= length; i += SCAN_BLOCK) {
+        count += (uint64_t) __builtin_popcountll(newline_mask(p + i));
+    }
+    return count + (uint64_t) __builtin_popcountll(newlineMaskScalar(p + i, length - i));
+}
+
+static void * countRange(void *arg)
+{
+    range_job *job = arg;
+    job->range.line_number = (long) countNewlines(job->start, job->length);
+    return NULL;
+}
+
+static void * parseRange(void *arg)
+{
+    range_job *job = arg;
+    task_segment *segment = job->segment;
+    task_record record;
+    int status;
+
+    // a guess from the average line of a few characters, grown as needed
+    segment->capacity = job->length / 4 + 16;
+    segment->records = malloc(segment->capacity * sizeof(task_record));
+    if (segment->records == NULL) {
+        return (void *) -1;
+    }
+    while ((status = taskReaderNext(&job->range, &record)) > 0) {
+        if (segment->count == segment->capacity) {
+            task_record *records = realloc(segment->records, 2 * segment->capacity * sizeof(task_record));
+            if (records == NULL) {
+                return (void *) -1;
+            }
+            segment->records = records;
+            segment->capacity *= 2;
+        }
+        segment->records[segment->count++] = record;
+    }
+    segment->status = status;
+    return NULL;
+}
+
+/*
+ * run fn on every job in its own thread; returns 0, or -1 with errno set
+ */
+static int runJobs(range_job *jobs, int count, void *(*fn)(void *))
+{
+    pthread_t *threads = malloc((size_t) count * sizeof(pthread_t));
+    int created = 0, failed = 0;
+
+    if (threads == NULL) {
+        return -1;
+    }
+    for (; created < count; created++) {
+        int s = pthread_create(&threads[created], NULL, fn, &jobs[created]);
+        if (s != 0) {
+            failed = s;
+            break;
+        }
+    }
+    for (int i = 0; i < created; i++) {
+        void *res;
+        pthread_join(threads[i], &res);
+        if (res != NULL && failed == 0) {
+            failed = ENOMEM;
+        }
+    }
+    free(threads);
+    if (failed != 0) {
+        errno = failed;
+        return -1;
+    }
+    return 0;
+}
+
+int taskReaderParseParallel(task_reader *reader, int num_threads)
+{
+    if (reader->format == TASK_FORMAT_BINARY || reader->size == 0) {
+        return 0; // records are indexed, not parsed
+    }
+    if ((size_t) num_threads > reader->size / MIN_RANGE_SIZE) {
+        num_threads = (int) (reader->size / MIN_RANGE_SIZE);
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    range_job *jobs = calloc((size_t) num_threads, sizeof(range_job));
+    reader->segments = calloc((size_t) num_threads, sizeof(task_segment));
+    if (jobs == NULL || reader->segments == NULL) {
+        free(jobs);
+        free(reader->segments);
+        reader->segments = NULL;
+        return -1;
+    }
+
+    // cut at the first newline after every equal share, so each range holds whole lines
+    size_t begin = 0;
+    int count = 0;
+    for (int i = 0; i < num_threads && begin < reader->size; i++) {
+        size_t end = reader->size * (size_t) (i + 1) / (size_t) num_threads;
+        if (end < begin) {
+            end = begin;
+        }
+        const char *newline = memchr(reader->data + end, '\n', reader->size - end);
+        end = i == num_threads - 1 || newline == NULL ? reader->size : (size_t) (newline - reader->data) + 1;
+        jobs[count].start = reader->data + begin;
+        jobs[count].length = end - begin;
+        count++;
+        begin = end;
+    }
+
+    reader->num_segments = count;
+
+    // count lines first, so every range reports errors with the file's line numbers
+    int status = runJobs(jobs, count, countRange);
+    long lines = 0;
+    for (int i = 0; status == 0 && i < count; i++) {
+        range_job *job = &jobs[i];
+        long range_lines = job->range.line_number;
+        job->range = *reader;
+        job->range.data = job->start;
+        job->range.size = job->length;
+        job->range.segments = NULL;
+        job->range.cursor = 0;
+        job->range.block = 0;
+        job->range.newlines = scanBlock(&job->range);
+        job->range.release_pages = false;
+        job->range.line_number = lines;
+        job->segment = &reader->segments[i];
+        lines += range_lines;
+    }
+    if (status == 0) {
+        status = runJobs(jobs, count, parseRange);
+    }
+    free(jobs);
+
+    reader->segment_index = 0;
+    reader->segment_next = 0;
+    if (status != 0) {
+        int saved = errno;
+        freeSegments(reader);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
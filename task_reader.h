@@ -0,0 +1,88 @@
+/*
+ * task_reader.h
+ *
+ * Streams "<op> <number>" records out of a task file one at a time, so a
+ * consumer can start working before the whole file has been read.
+ * The file is mmapped and parsed in place: newlines are located 64 bytes
+ * at a time with SIMD compares (AVX2 or SSE2 picked at runtime, scalar
+ * elsewhere) and numbers are decoded straight from the mapping.
+ * A text file can also be parsed up front by several threads, each taking a
+ * range of whole lines; the records then come out of the ranges in order.
+ */
+
+#ifndef TASK_READER_H
+#define TASK_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TASK_PROCESS 'p'
+#define TASK_WAIT 'w'
+
+typedef struct {
+    char op;    /* TASK_PROCESS or TASK_WAIT */
+    long value;
+} task_record;
+
+/* records parsed out of one byte range of a text file */
+typedef struct {
+    task_record *records;
+    size_t count, capacity;
+    int status;           /* 0, or -1 if the range has a malformed line */
+} task_segment;
+
+typedef enum {
+    TASK_FORMAT_TEXT,
+    TASK_FORMAT_BINARY,
+} task_format;
+
+typedef struct {
+    const char *path;
+    const char *data;     /* the whole file, read-only */
+    size_t size;
+    task_format format;
+    /* binary files */
+    const unsigned char *records;
+    uint64_t record_count;
+    uint64_t record_index;
+    char ops[256];        /* op table: code -> action */
+    unsigned op_count;
+    /* text files */
+    size_t cursor;        /* start of the next record */
+    size_t block;         /* offset of the 64-byte block being scanned */
+    uint64_t newlines;    /* unconsumed newline positions within that block */
+    size_t released;      /* pages before this offset were handed back to the kernel */
+    bool release_pages;   /* false for the range readers of a parallel parse */
+    long line_number;
+    /* parsed up front by taskReaderParseParallel */
+    task_segment *segments;
+    int num_segments;
+    int segment_index;
+    size_t segment_next;
+} task_reader;
+
+/*
+ * returns 0 on success, -1 with errno set if the file cannot be opened or
+ * mapped (EINVAL for a corrupt binary header)
+ */
+int taskReaderOpen(task_reader *reader, const char *path);
+void taskReaderClose(task_reader *reader);
+
+/*
+ * right after opening: parse a whole text file now with up to num_threads
+ * threads, splitting it into byte ranges that end on newlines; does nothing
+ * for binary files. A malformed line is printed during the parse and
+ * taskReaderNext returns -1 once it gets there.
+ * returns 0 on success, -1 with errno set if threads or memory ran out
+ */
+int taskReaderParseParallel(task_reader *reader, int num_threads);
+
+/*
+ * read the next record
+ * returns 1 when a record was read, 0 at end of file and -1 on a malformed
+ * line (after printing where to stderr)
+ */
+int taskReaderNext(task_reader *reader, task_record *record);
+
+#endif
@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+#
+# remote.sh <mode> <par_sum> <sum> <tasks>
+#
+# Runs a --serve master on a private socket with --connect workers on this
+# machine, all with the none kernel:
+#   batch     one worker with -c 8 must receive batches of 8 tasks, although
+#             the master keeps its default chunk of 1
+#   sum       two workers share the input
+#   mismatch  a worker with another --agg must be refused, the reason printed
+#             on both sides; a matching worker then does the work
+#
+# In every mode the master's "sum odd min max" line must match sum's.
+
+set -euo pipefail
+
+if [ $# -ne 4 ]; then
+    echo "Usage: $0 <mode> <par_sum> <sum> <tasks>" >&2
+    exit 1
+fi
+MODE=$1
+PAR_SUM=$2
+SUM=$3
+TASKS=$4
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+SOCKET=$DIR/master.sock
+
+"$PAR_SUM" --serve "$SOCKET" -k none -f "$TASKS" > "$DIR/master.out" 2> "$DIR/master.err" &
+MASTER=$!
+
+case $MODE in
+    batch)
+        # workers retry until the master listens
+        "$PAR_SUM" --connect "$SOCKET" -k none -c 8 -v > "$DIR/worker.out"
+        largest=$(sed -n 's/.* received \([0-9]*\) tasks$/\1/p' "$DIR/worker.out" | sort -n | tail -1)
+        if [ "${largest:-0}" -ne 8 ]; then
+            echo "largest batch received: ${largest:-none}, expected 8" >&2
+            exit 1
+        fi
+        ;;
+    sum)
+        "$PAR_SUM" --connect "$SOCKET" -k none -c 4 &
+        FIRST=$!
+        "$PAR_SUM" --connect "$SOCKET" -k none -c 16
+        wait "$FIRST"
+        ;;
+    mismatch)
+        if "$PAR_SUM" --connect "$SOCKET" -k none --agg basic,hll 2> "$DIR/worker.err"; then
+            echo "worker with --agg basic,hll was not refused" >&2
+            kill "$MASTER"
+            exit 1
+        fi
+        grep -q "^Master refused the connection: .*--agg basic,hll" "$DIR/worker.err"
+        "$PAR_SUM" --connect "$SOCKET" -k none
+        grep -q "^Refusing a worker: .*--agg basic,hll" "$DIR/master.err"
+        ;;
+    *)
+        echo "Unknown mode: $MODE" >&2
+        kill "$MASTER"
+        exit 1
+        ;;
+esac
+
+wait "$MASTER"
+expected=$("$SUM" -k none "$TASKS")
+got=$(head -1 "$DIR/master.out")
+if [ "$got" != "$expected" ]; then
+    echo "master printed '$got', sum printed '$expected'" >&2
+    exit 1
+fi
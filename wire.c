@@ -0,0 +1,91 @@
+/*
+ * wire.c
+ */
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "task_format.h"
+#include "wire.h"
+
+int wireSend(int fd, uint8_t type, const void *payload, uint32_t length)
+{
+    unsigned char header[WIRE_HEADER_SIZE];
+    const unsigned char *data = payload;
+    size_t sent = 0, total = WIRE_HEADER_SIZE + (size_t) length;
+
+    storeLe32(header, length);
+    header[4] = type;
+    while (sent < total) {
+        // header and payload in one segment when possible; no SIGPIPE for a dead peer
+        struct iovec parts[2];
+        struct msghdr msg = { .msg_iov = parts };
+        if (sent < WIRE_HEADER_SIZE) {
+            parts[0] = (struct iovec) { header + sent, WIRE_HEADER_SIZE - sent };
+            parts[1] = (struct iovec) { (void *) data, length };
+            msg.msg_iovlen = length > 0 ? 2 : 1;
+        } else {
+            parts[0] = (struct iovec) { (void *) (data + sent - WIRE_HEADER_SIZE), total - sent };
+            msg.msg_iovlen = 1;
+        }
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += (size_t) n;
+    }
+    return 0;
+}
+
+/*
+ * read exactly length bytes; returns 1, 0 on end of stream before any byte, -1 on error
+ */
+static int readFull(int fd, unsigned char *buffer, size_t length)
+{
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = read(fd, buffer + done, length - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            if (done == 0) {
+                return 0;
+            }
+            errno = EPROTO; // connection lost in the middle of a frame
+            return -1;
+        }
+        done += (size_t) n;
+    }
+    return 1;
+}
+
+int wireRecv(int fd, uint8_t *type, void *payload, uint32_t capacity, uint32_t *length)
+{
+    unsigned char header[WIRE_HEADER_SIZE];
+    int status = readFull(fd, header, WIRE_HEADER_SIZE);
+    if (status <= 0) {
+        return status;
+    }
+    *length = loadLe32(header);
+    *type = header[4];
+    if (*length > capacity) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (*length > 0 && (status = readFull(fd, payload, *length)) != 1) {
+        if (status == 0) {
+            errno = EPROTO; // closed between the header and the payload
+        }
+        return -1;
+    }
+    return 1;
+}
@@ -0,0 +1,48 @@
+/*
+ * wire.h
+ *
+ * Framing between a par_sum master and worker processes on a stream socket.
+ * A frame is a u32 little-endian payload length, a u8 type and the payload:
+ *
+ *   WIRE_HELLO    worker -> master  the worker's reductions, comma-separated
+ *                                   as in --agg; sent once, before any request
+ *                 master -> worker  empty: the reductions match, requests may follow
+ *   WIRE_REQUEST  worker -> master  u32 most tasks wanted, then the raw
+ *                                   accumulator states of the tasks of the
+ *                                   previous batch (absent on the first request)
+ *   WIRE_TASKS    master -> worker  i64 value of every task of the batch
+ *   WIRE_DONE     master -> worker  no task left, the worker may exit
+ *   WIRE_REFUSED  master -> worker  why the master closes the connection, as text
+ *
+ * A batch belongs to its worker until the next request carries its partial
+ * aggregates back; the batch of a worker that disconnects before that is
+ * handed to another worker.
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+
+#define WIRE_HEADER_SIZE 5
+#define WIRE_MAX_PAYLOAD 65536
+
+enum {
+    WIRE_REQUEST = 1,
+    WIRE_TASKS = 2,
+    WIRE_DONE = 3,
+    WIRE_HELLO = 4,
+    WIRE_REFUSED = 5,
+};
+
+/* write a whole frame; returns 0 on success, -1 with errno set */
+int wireSend(int fd, uint8_t type, const void *payload, uint32_t length);
+
+/*
+ * read a whole frame of at most capacity payload bytes
+ * returns 1 on success, 0 when the peer closed the connection between frames,
+ * -1 with errno set otherwise (EPROTO for an oversized or truncated frame)
+ */
+int wireRecv(int fd, uint8_t *type, void *payload, uint32_t capacity, uint32_t *length);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * ws_deque.c
+ */
+
+#include <stdlib.h>
+
+#include "ws_deque.h"
+
+static ws_buffer * bufferAlloc(size_t capacity)
+{
+    ws_buffer *buffer = malloc(sizeof(ws_buffer) + capacity * sizeof(task));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->mask = capacity - 1;
+    return buffer;
+}
+
+int wsDequeInit(ws_deque *deque, size_t capacity, epoch_domain *domain, int owner)
+{
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ws_buffer *buffer = bufferAlloc(size);
+    if (buffer == NULL) {
+        return -1;
+    }
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->buffer, buffer);
+    deque->domain = domain;
+    deque->owner = owner;
+    return 0;
+}
+
+void wsDequeDestroy(ws_deque *deque)
+{
+    // earlier buffers live in the epoch domain's limbo lists
+    free(atomic_load_explicit(&deque->buffer, memory_order_relaxed));
+    atomic_store_explicit(&deque->buffer, NULL, memory_order_relaxed);
+}
+
+/*
+ * copy the live range [top, bottom) into a buffer twice as large
+ */
+static ws_buffer * grow(ws_buffer *old, long top, long bottom)
+{
+    ws_buffer *buffer = bufferAlloc((old->mask + 1) * 2);
+    if (buffer == NULL) {
+        return NULL;
+    }
+    for (long i = top; i < bottom; i++) {
+        buffer->items[i & buffer->mask] = old->items[i & old->mask];
+    }
+    return buffer;
+}
+
+bool wsDequePush(ws_deque *deque, const task *item)
+{
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    ws_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+
+    if (bottom - top > (long) buffer->mask) {
+        ws_buffer *old = buffer;
+        buffer = grow(old, top, bottom);
+        if (buffer == NULL) {
+            return false;
+        }
+        atomic_store_explicit(&deque->buffer, buffer, memory_order_release);
+        epochRetire(deque->domain, deque->owner, &old->reclaim);
+    }
+    buffer->items[bottom & buffer->mask] = *item;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return true;
+}
+
+bool wsDequePop(ws_deque *deque, task *item)
+{
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    ws_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    bool found = true;
+
+    if (top <= bottom) {
+        *item = buffer->items[bottom & buffer->mask];
+        if (top == bottom) {
+            // last item: race against thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                         memory_order_seq_cst, memory_order_relaxed)) {
+                found = false;
+            }
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
+    } else {
+        found = false;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return found;
+}
+
+bool wsDequeSteal(ws_deque *deque, task *item)
+{
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom) {
+        return false;
+    }
+    ws_buffer *buffer = atomic_load_explicit(&deque->buffer, memory_order_acquire);
+    task stolen = buffer->items[top & buffer->mask];
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return false;
+    }
+    *item = stolen;
+    return true;
+}
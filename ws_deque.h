@@ -0,0 +1,52 @@
+/*
+ * ws_deque.h
+ *
+ * Chase-Lev work-stealing deque (Le, Pop, Cohen & Zappa Nardelli, PPoPP'13).
+ * The owner pushes and pops at the bottom without atomic read-modify-write
+ * operations; thieves take from the top with a CAS. The buffer doubles when
+ * it fills up; a replaced buffer is retired to an epoch domain and freed once
+ * no thief can still be reading from it, so thieves must call wsDequeSteal
+ * between epochEnter and epochExit.
+ */
+
+#ifndef WS_DEQUE_H
+#define WS_DEQUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cache_line.h"
+#include "epoch.h"
+#include "task.h"
+
+typedef struct ws_buffer ws_buffer;
+
+struct ws_buffer {
+    epoch_node reclaim; /* first member: the buffer is freed through it */
+    size_t mask;
+    task items[];
+};
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_long top;
+    _Alignas(CACHE_LINE_SIZE) atomic_long bottom;
+    _Atomic(ws_buffer *) buffer;
+    epoch_domain *domain; /* where replaced buffers are retired */
+    int owner;            /* the owner's participant number in domain */
+} ws_deque;
+
+/*
+ * returns 0 on success, -1 if the buffer could not be allocated
+ */
+int wsDequeInit(ws_deque *deque, size_t capacity, epoch_domain *domain, int owner);
+void wsDequeDestroy(ws_deque *deque);
+
+/* owner only; returns false if the buffer could not grow */
+bool wsDequePush(ws_deque *deque, const task *item);
+/* owner only; returns false when empty */
+bool wsDequePop(ws_deque *deque, task *item);
+/* any thread inside an epoch; returns false when empty or when it lost a race */
+bool wsDequeSteal(ws_deque *deque, task *item);
+
+#endif